@@ -2,10 +2,19 @@
 
 # include "readfits/readfits.h"
 # include "stardet/stardet.h"
+# include "catalogue/catalogue.h"
+# include "filter/filter.h"
+# include "warp/warp.h"
+
+# ifndef M_PI
+# define M_PI 3.14159265358979323846
+# endif
 
 // Some constants.
-int const N_stars = 300, // Max number of stars to extract.
-HIST_RES = 10; // Histogram x and y resolution.
+int const HIST_RES = 10, // Histogram x and y resolution.
+CLIP_ITER = 5; // Maximum number of sigma clipping iterations for the average star statistics.
+double const CLIP_KAPPA = 3.0, // Stars further than this many standard deviations from the mean are left out of the averages.
+REFINE_SIGMA = 1.5; // Blur radius of the unsharp mask in pixels.
 
 // Threshold above which a pixel will be checked for being a star.
 int detection_threshold (double avg){
@@ -14,11 +23,14 @@ int detection_threshold (double avg){
 
 
 picture img;
+catalogue cat;
+char const * path;
 double res = 0.0;
 
 /// @brief Closes file and free arrays so program can end safely.
 void close (){
     free(img.data); fclose(img.file);
+    catalogue_free(&cat); free(img.hdus);
 }
 
 /// @brief Round function.
@@ -45,6 +57,9 @@ void errhandle (int code){
         case -4:
             printf("Invalid file.\n");
             break;
+        case -5:
+            printf("Unsupported image format, only 8 and 16 bit integer images can be read.\n");
+            break;
         default:
             return;
     }
@@ -86,34 +101,145 @@ int print_histogram (int * max, double * stddev){
 }
 
 /// @brief Writes the file to a PPM file and marks the stars.
-void mark_stars (star stars [], int N){
+/// @return -1 if allocation failed or the file couldn't be opened, 0 otherwise.
+int mark_stars (){
+    double const * x = cat.col[CAT_X], * y = cat.col[CAT_Y], * FWHM = cat.col[CAT_FWHM];
+    unsigned char * mark = ( unsigned char * ) calloc(( long ) img.width*img.height, 1); // 1 on a circle, 2 on a center.
+    if (mark == NULL) return -1; // Malloc failed.
+
+    // Draw every star around its own position, the earlier stars are drawn last so they end up on top.
+    for (int i = cat.N - 1; i >= 0; i--){
+        if (FWHM[i] > 0.0){ // Circle of radius FWHM, only pixels within sqrt(FWHM^2 + FWHM) (+1 for truncation) can be on it.
+            int reach = ( int ) ceil(sqrt(FWHM[i]*FWHM[i] + FWHM[i])) + 1,
+            r0 = ( int ) floor(y[i]) - reach, r1 = ( int ) ceil(y[i]) + reach, c0 = ( int ) floor(x[i]) - reach, c1 = ( int ) ceil(x[i]) + reach;
+            r0 = r0 < 0 ? 0 : r0; r1 = r1 >= img.height ? img.height-1 : r1;
+            c0 = c0 < 0 ? 0 : c0; c1 = c1 >= img.width ? img.width-1 : c1;
+            for (int row = r0; row <= r1; row++) for (int col = c0; col <= c1; col++){
+                int xdist = row - y[i], ydist = col - x[i];
+                if (fabs(xdist*xdist + ydist*ydist - FWHM[i]*FWHM[i]) < FWHM[i]) mark[( long ) row*img.width + col] = 1;
+            }
+        }
+        int row = rd(y[i]), col = rd(x[i]);
+        if (row >= 0 && row < img.height && col >= 0 && col < img.width) mark[( long ) row*img.width + col] = 2;
+    }
+
     FILE * out = fopen("marked.ppm", "wb");
+    if (out == NULL) { free(mark); return -1; }
     fprintf(out, "P6\n%d %d\n255\n", img.width, img.height);
     for (int row = 0; row < img.height; row++) for (int col = 0; col < img.width; col++){
-        int close = 0, center = 0;
-        for (int i = 0; i < N; i++){
-            if (rd(stars[i].pos.y) == row && rd(stars[i].pos.x) == col) { center = 1; break; }
-            int xdist = row - stars[i].pos.y, ydist = col - stars[i].pos.x;
-            if (fabs(xdist*xdist + ydist*ydist - stars[i].FWHM*stars[i].FWHM) < stars[i].FWHM) { close = 1; break; }
-        }
-
-        if (close) { fputc(0, out); fputc(255, out); fputc(0, out); } // Green.
-        else if (center) { fputc(255, out); fputc(0, out); fputc(0, out); } // Red.
+        int m = mark[( long ) row*img.width + col];
+        if (m == 1) { fputc(0, out); fputc(255, out); fputc(0, out); } // Green.
+        else if (m == 2) { fputc(255, out); fputc(0, out); fputc(0, out); } // Red.
         else for (int i = 0; i < 3; i++) fputc(img.data[row*img.width*4 + col*4 + i + 1] >> 8, out); // Data. (Greyscale)
     }
     fclose(out);
+
+    free(mark);
+    return 0;
 }
 
-/// @brief Calculates average star statistics.
-void calc_avg (star * avg, star stars [], int N){
-    for (int i = 0; i < N; i++){
-        avg->e += stars[i].e;
-        avg->angle += stars[i].angle;
-        avg->FWHM += stars[i].FWHM;
-        avg->HFD += stars[i].HFD;
-        avg->SNR += stars[i].SNR;
+/// @brief Writes the monochrome values of the picture to a PGM file, with 2 bytes per value if the maximum needs it.
+/// @return -1 if the file couldn't be opened, 0 otherwise.
+int write_pgm (picture const * pic, char const * name){
+    FILE * out = fopen(name, "wb");
+    if (out == NULL) return -1;
+    fprintf(out, "P5\n%d %d\n%d\n", pic->width, pic->height, pic->max);
+    for (long i = 0; i < ( long ) pic->width*pic->height; i++){
+        if (pic->max > 255) fputc(pic->data[i*4] >> 8, out); // Most significant byte first.
+        fputc(pic->data[i*4] & 0xff, out);
     }
-    if (N > 0) { avg->e /= N; avg->angle /= N; avg->FWHM /= N; avg->HFD /= N; avg->SNR /= N; }
+    fclose(out);
+    return 0;
+}
+
+/// @brief Sharpens, denoises or smooths a copy of the picture and writes it to refined.pgm.
+void refine (){
+    char c; double v;
+    printf("\nPlease select a filter.\n[G]aussian blur  [U]nsharp mask  [W]avelet sharpen  [D]enoise  [M]atched filter\n");
+    scanf(" %c", &c);
+    switch (c){
+        case 'g': case 'G': printf("Sigma in pixels: "); break;
+        case 'u': case 'U': printf("Amount: "); break;
+        case 'w': case 'W': printf("Strength: "); break;
+        case 'd': case 'D': printf("Threshold in noise deviations: "); break;
+        case 'm': case 'M': printf("Star FWHM in pixels: "); break;
+        default: printf("Invalid filter.\n"); return;
+    }
+    if (scanf("%lf", &v) != 1) { printf("Invalid value.\n"); return; }
+
+    // Filter a copy so the analysis keeps using the original.
+    picture copy = img; long size = ( long ) img.width*img.height*4;
+    copy.data = ( unsigned short * ) malloc(size * sizeof(unsigned short));
+    if (copy.data == NULL) { printf("Allocation failed.\n"); return; }
+    memcpy(copy.data, img.data, size * sizeof(unsigned short));
+
+    printf("\nFiltering...\n");
+    int err = 0;
+    double gain [] = {1.0 + v, 1.0 + v/2.0, 1.0 + v/4.0}, noise [] = {v, v/2.0, v/4.0}; // Strongest on the finest wavelet layers.
+    switch (c){
+        case 'g': case 'G': err = gaussian_blur(&copy, v); break;
+        case 'u': case 'U': err = unsharp_mask(&copy, REFINE_SIGMA, v); break;
+        case 'w': case 'W': err = wavelet_filter(&copy, 3, gain, NULL); break;
+        case 'd': case 'D': err = wavelet_filter(&copy, 3, NULL, noise); break;
+        case 'm': case 'M': err = matched_filter(&copy, v); break;
+    }
+
+    if (err == -1) printf("Allocation failed.\n");
+    else if (write_pgm(&copy, "refined.pgm") == -1) printf("Couldn't write refined.pgm.\n");
+    else printf("Done!\n");
+    free(copy.data);
+}
+
+/// @brief Shifts and rotates a copy of the picture and writes it to aligned.pgm.
+void align (){
+    char c; double dx, dy, angle;
+    warp_kernel kernel;
+    printf("\nPlease select a resampling kernel.\n[B]ilinear  Bi[C]ubic  [L]anczos-3\n");
+    scanf(" %c", &c);
+    switch (c){
+        case 'b': case 'B': kernel = WARP_BILINEAR; break;
+        case 'c': case 'C': kernel = WARP_BICUBIC; break;
+        case 'l': case 'L': kernel = WARP_LANCZOS3; break;
+        default: printf("Invalid kernel.\n"); return;
+    }
+    printf("Shift in pixels (x y) and rotation in degrees: ");
+    if (scanf("%lf %lf %lf", &dx, &dy, &angle) != 3) { printf("Invalid value.\n"); return; }
+
+    // Rotate around the center of the picture, then shift.
+    double t = angle * M_PI / 180.0, cx = ( double ) (img.width - 1) / 2.0, cy = ( double ) (img.height - 1) / 2.0;
+    affine T = {cos(t), -sin(t), 0.0, sin(t), cos(t), 0.0}, inv;
+    T.c = cx - T.a*cx - T.b*cy + dx; T.f = cy - T.d*cx - T.e*cy + dy;
+    invert_affine(&T, &inv); // A rotation can always be inverted.
+
+    picture copy = img; long size = ( long ) img.width*img.height*4;
+    copy.data = ( unsigned short * ) malloc(size * sizeof(unsigned short));
+    if (copy.data == NULL) { printf("Allocation failed.\n"); return; }
+
+    printf("\nWarping...\n");
+    if (warp_picture(&img, &inv, kernel, copy.data) == -1) printf("Allocation failed.\n");
+    else if (write_pgm(&copy, "aligned.pgm") == -1) printf("Couldn't write aligned.pgm.\n");
+    else printf("Done!\n");
+    free(copy.data);
+}
+
+/// @brief Calculates average star statistics, leaving out outlier stars.
+void calc_avg (star * avg){
+    if (cat.N == 0) return;
+    avg->e = catalogue_clipped_mean(&cat, CAT_E, CLIP_KAPPA, CLIP_ITER);
+    avg->angle = catalogue_clipped_mean(&cat, CAT_ANGLE, CLIP_KAPPA, CLIP_ITER);
+    avg->FWHM = catalogue_clipped_mean(&cat, CAT_FWHM, CLIP_KAPPA, CLIP_ITER);
+    avg->HFD = catalogue_clipped_mean(&cat, CAT_HFD, CLIP_KAPPA, CLIP_ITER);
+    avg->SNR = catalogue_clipped_mean(&cat, CAT_SNR, CLIP_KAPPA, CLIP_ITER);
+}
+
+/// @brief Calculates median star statistics.
+void calc_median (star * med){
+    if (cat.N == 0) return;
+    med->e = catalogue_median(&cat, CAT_E);
+    med->angle = catalogue_median(&cat, CAT_ANGLE);
+    med->FWHM = catalogue_median(&cat, CAT_FWHM);
+    med->HFD = catalogue_median(&cat, CAT_HFD);
+    med->SNR = catalogue_median(&cat, CAT_SNR);
 }
 
 /// @brief Prints the parameters of a given star.
@@ -129,17 +255,48 @@ void print_star (star * star, int i, int avg){
     printf("\tSNR: %.2lf dB\n", star->SNR);
 }
 
+/// @brief Extracts the stars of every plane in the file and prints their median statistics.
+void print_planes (){
+    long N_planes = 0;
+    for (int i = 0; i < img.N_hdus; i++) N_planes += img.hdus[i].planes;
+    if (N_planes < 2) { printf("\nThis file only has a single image.\n"); return; }
+
+    printf("\nAnalysing %ld planes... (HDUs and planes are numbered from 0, HDU 0 is the primary array)\n\n", N_planes);
+    plane_result * results;
+    int N = analyse_planes(path, img.hdus, img.N_hdus, detection_threshold, &results);
+    if (N == -3) { printf("Allocation failed.\n"); return; }
+
+    catalogue plane_cat; catalogue_init(&plane_cat);
+    for (int i = 0; i < N; i++){
+        printf("HDU %d, plane %ld: ", results[i].hdu, results[i].plane);
+        if (results[i].err == -5) { printf("unsupported format.\n"); continue; }
+        if (results[i].err) { printf("couldn't be read.\n"); continue; }
+
+        plane_cat.N = 0; // Reuse the columns for every plane.
+        if (catalogue_append(&plane_cat, results[i].stars, results[i].N) == -1) { printf("allocation failed.\n"); continue; }
+        printf("mean %.1lf, threshold %d, %d stars, median FWHM %.2lf px, median HFD %.2lf px, median SNR %.2lf dB\n", results[i].avg, results[i].thres, results[i].N, catalogue_median(&plane_cat, CAT_FWHM), catalogue_median(&plane_cat, CAT_HFD), catalogue_median(&plane_cat, CAT_SNR));
+    }
+
+    catalogue_free(&plane_cat);
+    free_plane_results(results, N);
+}
+
 /// @brief Prints the user interface.
-void UI (star stars [], int N){
+void UI (){
+    int N = cat.N;
     char c;
     while (1){
-        printf("Please select an option.\n[F]ile info  [H]istogram  [S]tatistics  [L]ist stars  [M]ark stars  [Q]uit\n");
+        printf("Please select an option.\n[F]ile info  [H]istogram  [S]tatistics  [L]ist stars  [M]ark stars  [E]xport stars  [P]lanes  [R]efine  [A]lign  [Q]uit\n");
         scanf("%c", &c);
 
         switch (c){
             case 'f': case 'F':
                 printf("\nFile information:\n\tFile type: %s\n\tDimensions: %d X %d\n\tMaximum pixel value: %d\n", img.PGM ? "Pixel Gray Map (PGM)" : "Flexible Image Transport System (FITS)", img.width, img.height, img.max);
                 if (!img.PGM) printf("\tResolution: %.2lf \"/px\n", res);
+                if (img.N_hdus > 0){
+                    long N_planes = 0; for (int i = 0; i < img.N_hdus; i++) N_planes += img.hdus[i].planes;
+                    printf("\tImages: %ld in %d HDU%s\n", N_planes, img.N_hdus, img.N_hdus == 1 ? "" : "s");
+                }
                 break;
             case 'h': case 'H':
                 printf("\nHistogram (logarithmic):\n");
@@ -149,20 +306,36 @@ void UI (star stars [], int N){
                 printf("\nMinimum:   %d (%.2lf %%)\nMaximum:   %d (%.2lf %%)\nMean:      %d (%.2lf %%)\nDeviation: %.2lf\n", min, 100.0 * ( double ) min / ( double ) img.max, max, 100.0 * ( double ) max / ( double ) img.max, rd(img.avg), 100.0 * img.avg / ( double ) img.max, stddev);
                 break;
             case 's': case 'S':
-                star avg = {0}; calc_avg(&avg, stars, N);
+                star avg = {0}, med = {0}; calc_avg(&avg); calc_median(&med);
                 if (N == 1) printf("\nExtracted 1 star.\n"); else printf("\nExtracted %d stars.\n", N);
                 printf("Mean pixel value: %d (%.1lf %%)\nThreshold: %d (%.1lf %%)\nAverage star statistics:\n", rd(img.avg), 100.0 * img.avg / ( double ) img.max, img.thres, 100.0 * ( double ) img.thres / ( double ) img.max);
                 print_star(&avg, 0, 1);
+                printf("Median star statistics:\n");
+                print_star(&med, 0, 1);
                 break;
             case 'l': case 'L':
                 if (N == 1) printf("\nExtracted 1 star.\n\n");
                 else printf("\nExtracted %d stars.\n\n", N);
-                for (int i = 0; i < N; i++) print_star(&stars[i], i, 0);
+                for (int i = 0; i < N; i++) { star s; catalogue_get(&cat, i, &s); print_star(&s, i, 0); }
                 break;
             case 'm': case 'M':
                 printf("\nConverting...\n");
-                mark_stars(stars, N);
-                printf("Done!\n");
+                if (mark_stars() == -1) printf("Couldn't write marked.ppm.\n");
+                else printf("Done!\n");
+                break;
+            case 'e': case 'E':
+                printf("\nExporting...\n");
+                if (catalogue_export(&cat, "stars.cat") == -1) printf("Couldn't write stars.cat.\n");
+                else printf("Done!\n");
+                break;
+            case 'p': case 'P':
+                print_planes();
+                break;
+            case 'r': case 'R':
+                refine();
+                break;
+            case 'a': case 'A':
+                align();
                 break;
             case 'q': case 'Q':
                 printf("\nExiting...\n");
@@ -189,17 +362,25 @@ float get_resolution (){
 }
 
 int main (int argc, char const ** argv){
-    star stars [N_stars]; int err;
+    int err;
 
     err = argc < 2; errhandle(err); // Check for path
 
-    err = read_starfile(argv[1], &img); errhandle(err); // Read file
+    path = argv[1];
+    err = read_starfile(path, &img); errhandle(err); // Read file
     res = get_resolution();
     img.thres = detection_threshold(img.avg);
 
-    int n_extracted_stars = extract_stars(&img, stars, N_stars); // Extract star positions
+    star * stars;
+    int n_extracted_stars = extract_all_stars(&img, &stars); // Extract star positions
+    if (n_extracted_stars == -1) { close(); errhandle(-3); }
+
+    catalogue_init(&cat);
+    err = catalogue_append(&cat, stars, n_extracted_stars); // Store star statistics per column
+    free(stars); // The catalogue is the only copy from here on.
+    if (err == -1) { close(); errhandle(-3); }
 
-    UI(stars, n_extracted_stars); // Print user interface
+    UI(); // Print user interface
 
     close();
     return 0;
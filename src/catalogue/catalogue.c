@@ -0,0 +1,222 @@
+# include "catalogue.h"
+
+# include <string.h>
+# include <float.h>
+
+// Some constants.
+int const __INITIAL_CAP = 256; // Number of stars to allocate room for on the first push.
+char const * __CAT_MAGIC = "SNSCAT01"; // Identifies exported catalogue files.
+
+/// @brief Initialises an empty catalogue.
+void catalogue_init (catalogue * cat){
+    cat->N = 0; cat->cap = 0;
+    for (int m = 0; m < CAT_COLUMNS; m++) cat->col[m] = NULL;
+}
+
+/// @brief Frees the columns of a catalogue and leaves it empty.
+void catalogue_free (catalogue * cat){
+    for (int m = 0; m < CAT_COLUMNS; m++) free(cat->col[m]);
+    catalogue_init(cat);
+}
+
+/// @brief Makes room for at least N stars in every column.
+/// @return -1 if allocation failed, 0 otherwise.
+int __reserve (catalogue * cat, int N){
+    if (N <= cat->cap) return 0;
+
+    int cap = cat->cap ? cat->cap : __INITIAL_CAP;
+    while (cap < N) cap *= 2; // Grow geometrically so pushing stays amortised constant time.
+
+    for (int m = 0; m < CAT_COLUMNS; m++){
+        double * col = ( double * ) realloc(cat->col[m], cap * sizeof(double));
+        if (col == NULL) return -1; // Realloc failed, already grown columns are still valid.
+        cat->col[m] = col;
+    }
+    cat->cap = cap;
+
+    return 0;
+}
+
+/// @brief Appends a star to the catalogue, growing the columns if needed.
+/// @return -1 if allocation failed, 0 otherwise.
+int catalogue_push (catalogue * cat, star const * s){
+    return catalogue_append(cat, s, 1);
+}
+
+/// @brief Appends N stars from an array to the catalogue.
+/// @return -1 if allocation failed, 0 otherwise.
+int catalogue_append (catalogue * cat, star const stars [], int N){
+    if (__reserve(cat, cat->N + N) == -1) return -1;
+
+    // Scatter the star structs into the columns.
+    for (int i = 0; i < N; i++){
+        int j = cat->N + i;
+        cat->col[CAT_X][j] = stars[i].pos.x;
+        cat->col[CAT_Y][j] = stars[i].pos.y;
+        cat->col[CAT_E][j] = stars[i].e;
+        cat->col[CAT_ANGLE][j] = stars[i].angle;
+        cat->col[CAT_FWHM][j] = stars[i].FWHM;
+        cat->col[CAT_SNR][j] = stars[i].SNR;
+        cat->col[CAT_HFD][j] = stars[i].HFD;
+    }
+    cat->N += N;
+
+    return 0;
+}
+
+/// @brief Gathers the columns of a single star back into a star struct.
+/// @param i Index of the star, should be below cat->N.
+void catalogue_get (catalogue const * cat, int i, star * s){
+    s->pos.x = cat->col[CAT_X][i];
+    s->pos.y = cat->col[CAT_Y][i];
+    s->e = cat->col[CAT_E][i];
+    s->angle = cat->col[CAT_ANGLE][i];
+    s->FWHM = cat->col[CAT_FWHM][i];
+    s->SNR = cat->col[CAT_SNR][i];
+    s->HFD = cat->col[CAT_HFD][i];
+}
+
+/// @brief Calculates the mean of a metric.
+/// @return The mean; NAN if the catalogue is empty.
+double catalogue_mean (catalogue const * cat, metric m){
+    if (cat->N == 0) return NAN;
+
+    double const * x = cat->col[m];
+    double s = 0.0;
+    for (int i = 0; i < cat->N; i++) s += x[i];
+
+    return s / ( double ) cat->N;
+}
+
+/// @brief Partially sorts the array so that the k-th smallest value ends up at index k. (Quickselect)
+/// @return The k-th smallest value.
+double __select (double a [], int N, int k){
+    int lo = 0, hi = N - 1;
+
+    while (lo < hi){
+        double pivot = a[lo + (hi - lo) / 2];
+        int i = lo, j = hi;
+
+        // Hoare partition around the pivot.
+        while (i <= j){
+            while (a[i] < pivot) i++;
+            while (a[j] > pivot) j--;
+            if (i <= j) { double t = a[i]; a[i] = a[j]; a[j] = t; i++; j--; }
+        }
+
+        // Only continue in the part that contains k.
+        if (k <= j) hi = j;
+        else if (k >= i) lo = i;
+        else break;
+    }
+
+    return a[k];
+}
+
+/// @brief Calculates the given percentile of a metric, interpolating between ranks.
+/// @param p Percentile between 0 and 100.
+/// @return The percentile; NAN if the catalogue is empty or allocation failed.
+double catalogue_percentile (catalogue const * cat, metric m, double p){
+    if (cat->N == 0) return NAN;
+    if (p < 0.0) p = 0.0;
+    if (p > 100.0) p = 100.0;
+
+    double * buf = ( double * ) malloc(cat->N * sizeof(double)); // Selecting reorders the values, so work on a copy.
+    if (buf == NULL) return NAN; // Malloc failed.
+    memcpy(buf, cat->col[m], cat->N * sizeof(double));
+
+    double rank = p / 100.0 * ( double ) (cat->N - 1);
+    int k = ( int ) floor(rank);
+    double lower = __select(buf, cat->N, k), ret = lower;
+
+    if (k + 1 < cat->N && rank > ( double ) k){
+        // Everything after index k is at least as large as the k-th value, so the next rank is the smallest of those.
+        double upper = buf[k + 1];
+        for (int i = k + 2; i < cat->N; i++) upper = buf[i] < upper ? buf[i] : upper;
+        ret = lower + (rank - ( double ) k) * (upper - lower);
+    }
+
+    free(buf);
+    return ret;
+}
+
+/// @brief Calculates the median of a metric.
+/// @return The median; NAN if the catalogue is empty or allocation failed.
+double catalogue_median (catalogue const * cat, metric m){
+    return catalogue_percentile(cat, m, 50.0);
+}
+
+/// @brief Calculates the mean of a metric after iteratively rejecting values more than kappa standard deviations from the mean.
+/// Infinite and NaN values are always rejected.
+/// @param kappa Rejection threshold in standard deviations.
+/// @param iter Maximum number of rejection iterations.
+/// @return The clipped mean; NAN if the catalogue is empty or has no finite values.
+double catalogue_clipped_mean (catalogue const * cat, metric m, double kappa, int iter){
+    if (cat->N == 0) return NAN;
+
+    double const * x = cat->col[m];
+    double lo = -DBL_MAX, hi = DBL_MAX, mean = NAN; // Non-finite values are never within the bounds.
+    int prev = -1;
+
+    for (int it = 0; it <= iter; it++){
+        // Accumulate over the values within the bounds.
+        double s = 0.0, ss = 0.0, c = 0.0;
+        for (int i = 0; i < cat->N; i++) if (x[i] >= lo && x[i] <= hi){
+            s += x[i]; ss += x[i] * x[i]; c += 1.0;
+        }
+        if (c == 0.0) break; // Everything got rejected, keep the previous mean.
+
+        mean = s / c;
+        if (( int ) c == prev) break; // Nothing was rejected, converged.
+        prev = ( int ) c;
+
+        double var = ss / c - mean * mean;
+        double stddev = var > 0.0 ? sqrt(var) : 0.0;
+        lo = mean - kappa * stddev; hi = mean + kappa * stddev;
+    }
+
+    return mean;
+}
+
+/// @brief Calculates the weighted mean and standard deviation of a metric.
+/// @param w Weights, one per star. Can be another column of the catalogue.
+/// @param stddev Stores the weighted standard deviation here, can be NULL.
+/// @return The weighted mean; NAN if the catalogue is empty or the weights add up to zero.
+double catalogue_weighted_mean (catalogue const * cat, metric m, double const w [], double * stddev){
+    if (stddev != NULL) *stddev = NAN;
+    if (cat->N == 0) return NAN;
+
+    double const * x = cat->col[m];
+    double s = 0.0, ss = 0.0, ws = 0.0;
+    for (int i = 0; i < cat->N; i++){
+        s += w[i] * x[i]; ss += w[i] * x[i] * x[i]; ws += w[i];
+    }
+    if (ws == 0.0) return NAN;
+
+    double mean = s / ws;
+    if (stddev != NULL){
+        double var = ss / ws - mean * mean;
+        *stddev = var > 0.0 ? sqrt(var) : 0.0;
+    }
+
+    return mean;
+}
+
+/// @brief Writes the catalogue to a binary file, one column after another.
+/// @return -1 if the file couldn't be opened or written, 0 otherwise.
+int catalogue_export (catalogue const * cat, char const * path){
+    FILE * out = fopen(path, "wb");
+    if (out == NULL) return -1;
+
+    // Header: magic, number of stars, number of columns.
+    int header [] = {cat->N, CAT_COLUMNS}, err = 0;
+    if (fwrite(__CAT_MAGIC, 1, 8, out) != 8) err = -1;
+    if (!err && fwrite(header, sizeof(int), 2, out) != 2) err = -1;
+
+    // Columns in the order of the metric enum, native byte order.
+    for (int m = 0; m < CAT_COLUMNS && !err; m++)
+        if (fwrite(cat->col[m], sizeof(double), cat->N, out) != ( size_t ) cat->N) err = -1;
+
+    if (fclose(out) != 0) err = -1;
+    return err;
+}
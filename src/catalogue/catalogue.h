@@ -0,0 +1,77 @@
+# ifndef CATALOGUE_H__
+# define CATALOGUE_H__
+
+# include <stdio.h>
+# include <stdlib.h>
+# include <math.h>
+
+# include "../stardet/stardet.h"
+
+// Star metrics, each stored as its own column in a catalogue.
+typedef enum {
+    CAT_X, // Star x position.
+    CAT_Y, // Star y position.
+    CAT_E, // Star eccentricity.
+    CAT_ANGLE, // Star major axis inclination.
+    CAT_FWHM, // Star full width at half maximum.
+    CAT_SNR, // Star signal to noise ratio.
+    CAT_HFD, // Star half flux diameter.
+    CAT_COLUMNS // Number of columns, not a metric.
+} metric;
+
+// Growable structure-of-arrays star catalogue.
+typedef struct {
+    int N; // Number of stars in the catalogue.
+    int cap; // Number of stars the columns have room for.
+    double * col [CAT_COLUMNS]; // One contiguous array per metric.
+} catalogue;
+
+/// @brief Initialises an empty catalogue.
+void catalogue_init (catalogue * cat);
+
+/// @brief Frees the columns of a catalogue and leaves it empty.
+void catalogue_free (catalogue * cat);
+
+/// @brief Appends a star to the catalogue, growing the columns if needed.
+/// @return -1 if allocation failed, 0 otherwise.
+int catalogue_push (catalogue * cat, star const * s);
+
+/// @brief Appends N stars from an array to the catalogue.
+/// @return -1 if allocation failed, 0 otherwise.
+int catalogue_append (catalogue * cat, star const stars [], int N);
+
+/// @brief Gathers the columns of a single star back into a star struct.
+/// @param i Index of the star, should be below cat->N.
+void catalogue_get (catalogue const * cat, int i, star * s);
+
+/// @brief Calculates the mean of a metric.
+/// @return The mean; NAN if the catalogue is empty.
+double catalogue_mean (catalogue const * cat, metric m);
+
+/// @brief Calculates the given percentile of a metric, interpolating between ranks.
+/// @param p Percentile between 0 and 100.
+/// @return The percentile; NAN if the catalogue is empty or allocation failed.
+double catalogue_percentile (catalogue const * cat, metric m, double p);
+
+/// @brief Calculates the median of a metric.
+/// @return The median; NAN if the catalogue is empty or allocation failed.
+double catalogue_median (catalogue const * cat, metric m);
+
+/// @brief Calculates the mean of a metric after iteratively rejecting values more than kappa standard deviations from the mean.
+/// Infinite and NaN values are always rejected.
+/// @param kappa Rejection threshold in standard deviations.
+/// @param iter Maximum number of rejection iterations.
+/// @return The clipped mean; NAN if the catalogue is empty or has no finite values.
+double catalogue_clipped_mean (catalogue const * cat, metric m, double kappa, int iter);
+
+/// @brief Calculates the weighted mean and standard deviation of a metric.
+/// @param w Weights, one per star. Can be another column of the catalogue.
+/// @param stddev Stores the weighted standard deviation here, can be NULL.
+/// @return The weighted mean; NAN if the catalogue is empty or the weights add up to zero.
+double catalogue_weighted_mean (catalogue const * cat, metric m, double const w [], double * stddev);
+
+/// @brief Writes the catalogue to a binary file, one column after another.
+/// @return -1 if the file couldn't be opened or written, 0 otherwise.
+int catalogue_export (catalogue const * cat, char const * path);
+
+# endif
@@ -0,0 +1,374 @@
+# include "filter.h"
+# include "../threads/threads.h"
+
+# ifndef M_PI
+# define M_PI 3.14159265358979323846
+# endif
+
+// Some constants.
+int const __CH = 4, // Values per pixel. (Mono, R, G, B)
+__TILE = 64; // Width in pixels of the tiles the vertical pass works through a row in.
+
+// B3 spline kernel of the a trous wavelet transform, from the center outwards.
+float const __B3 [] = {0.375f, 0.25f, 0.0625f};
+
+// Pixel data to filter, either the picture data or a float scratch plane.
+typedef struct {
+    unsigned short * u; // 16 bit data, NULL if f is used.
+    float * f; // Float data, NULL if u is used.
+    int width; // Plane width.
+    int height; // Plane height.
+} __plane;
+
+// Symmetric separable kernel.
+typedef struct {
+    float const * k; // Weights from the center outwards, r+1 of them.
+    int r; // Kernel radius in taps.
+    int step; // Distance in pixels between taps, larger than 1 for the a trous holes.
+} __kernel;
+
+// Called with each convolved row instead of storing it, the plane still holds the original row y.
+typedef void (* __row_fn) (void * ctx, int y, float const * out);
+
+// Arguments shared by the threads of a convolution.
+typedef struct {
+    __plane * p; // Plane to convolve in place.
+    __kernel const * k; // Kernel to convolve with.
+    __row_fn row; // Handles the convolved rows, NULL stores them in the plane.
+    void * ctx; // Passed to row.
+    int bands; // Number of row bands the plane is split in.
+    float ** halo; // Per band, the horizontally filtered rows just above and below it.
+    int err; // Set to -1 by a thread if its allocation failed.
+} __conv_args;
+
+// Arguments shared by the threads of the per pixel passes.
+typedef struct {
+    picture * img; // Picture to read from or write to.
+    float * c; // Smooth plane.
+    float * w; // Detail plane, or the sum of the processed layers in wavelet_filter.
+    unsigned short * blur; // Blurred copy for the unsharp mask.
+    double amount; // Unsharp mask strength.
+    float gain; // Gain of the current wavelet layer.
+    float thres [4]; // Soft threshold of the current wavelet layer per channel.
+    double * sums; // Sum of absolute detail values per row and channel, only the convolved rows are summed if set.
+} __pix_args;
+
+/// @brief Converts n pixels of a plane row starting at x0 to floats.
+void __load (__plane const * p, int y, int x0, int n, float * dst){
+    long off = (( long ) y*p->width + x0) * __CH;
+    if (p->f != NULL) { memcpy(dst, p->f + off, n * __CH * sizeof(float)); return; }
+    unsigned short const * src = p->u + off;
+    for (int j = 0; j < n*__CH; j++) dst[j] = ( float ) src[j];
+}
+
+/// @brief Writes n float pixels back to a plane row starting at x0, rounding and clamping if the plane is 16 bit.
+void __store (__plane * p, int y, int x0, int n, float const * src){
+    long off = (( long ) y*p->width + x0) * __CH;
+    if (p->f != NULL) { memcpy(p->f + off, src, n * __CH * sizeof(float)); return; }
+    unsigned short * dst = p->u + off;
+    for (int j = 0; j < n*__CH; j++){
+        float v = src[j] + 0.5f;
+        v = v < 0.0f ? 0.0f : v; v = v > 65535.0f ? 65535.0f : v;
+        dst[j] = ( unsigned short ) v;
+    }
+}
+
+/// @brief Weighted sum of 2r+1 lines of n values, the inner loop of both passes.
+/// @param tap Lines to add up, tap[r] is the center one.
+void __conv_taps (float * restrict out, float const * const tap [], float const * k, int r, int n){
+    float const * c = tap[r];
+    for (int j = 0; j < n; j++) out[j] = k[0] * c[j];
+    for (int i = 1; i <= r; i++){ // Symmetric, so pairs of taps share a weight.
+        float const * a = tap[r-i], * b = tap[r+i];
+        for (int j = 0; j < n; j++) out[j] += k[i] * (a[j] + b[j]);
+    }
+}
+
+/// @brief Filters a plane row horizontally, the result stays in float so the picture is only rounded once.
+/// @param in Scratch row with room for the kernel reach on both sides.
+void __hfilter (__plane const * p, __kernel const * k, int y, float * in, float * out){
+    int pad = k->r * k->step, W = p->width;
+    float const * tap [2*k->r + 1];
+
+    float * row = in + pad*__CH;
+    for (int i = -k->r; i <= k->r; i++) tap[i + k->r] = row + i*k->step*__CH;
+
+    __load(p, y, 0, W, row);
+    for (int x = 0; x < pad; x++) for (int c = 0; c < __CH; c++){ // Replicate the edge pixels into the padding.
+        in[x*__CH + c] = row[c];
+        row[(W + x)*__CH + c] = row[(W-1)*__CH + c];
+    }
+    __conv_taps(out, tap, k->k, k->r, W*__CH);
+}
+
+/// @brief First row of a band.
+int __band_start (__conv_args const * a, int b){
+    return ( int ) (( long ) a->p->height * b / a->bands);
+}
+
+/// @brief Filters the rows just outside a band of bands horizontally, before any band overwrites them.
+void __conv_halo (void * arg, int start, int end){
+    __conv_args * a = ( __conv_args * ) arg;
+    __plane * p = a->p; __kernel const * k = a->k;
+    int pad = k->r * k->step, W = p->width, H = p->height;
+
+    for (int b = start; b < end; b++){
+        int r0 = __band_start(a, b), r1 = __band_start(a, b+1);
+        float * halo = ( float * ) malloc(2 * pad * W * __CH * sizeof(float)), // Rows above the band, then rows below it.
+        * in = ( float * ) malloc((W + 2*pad) * __CH * sizeof(float));
+        if (halo == NULL || in == NULL) { a->err = -1; free(halo); free(in); continue; } // Malloc failed.
+        a->halo[b] = halo;
+
+        for (int r = r0 - pad; r < r0; r++) if (r >= 0) __hfilter(p, k, r, in, halo + ( long ) (r - r0 + pad)*W*__CH);
+        for (int r = r1; r < r1 + pad; r++) if (r < H) __hfilter(p, k, r, in, halo + ( long ) (pad + r - r1)*W*__CH);
+        free(in);
+    }
+}
+
+/// @brief Filters a band of bands vertically in place.
+/// The horizontally filtered rows of a band stream through a ring buffer the height of the kernel, the rows outside it come from its halo.
+void __conv_bands (void * arg, int start, int end){
+    __conv_args * a = ( __conv_args * ) arg;
+    __plane * p = a->p; __kernel const * k = a->k;
+    int pad = k->r * k->step, R = 2*pad + 1, W = p->width, H = p->height;
+    long len = ( long ) W*__CH;
+    float const * tap [2*k->r + 1], * chunk [2*k->r + 1];
+
+    float * ring = ( float * ) malloc(R * len * sizeof(float)),
+    * in = ( float * ) malloc((W + 2*pad) * __CH * sizeof(float)),
+    * out = ( float * ) malloc(len * sizeof(float));
+    if (ring == NULL || in == NULL || out == NULL) { a->err = -1; free(ring); free(in); free(out); return; } // Malloc failed.
+
+    for (int b = start; b < end; b++){
+        int r0 = __band_start(a, b), r1 = __band_start(a, b+1), loaded = r0;
+        float const * halo = a->halo[b];
+
+        for (int y = r0; y < r1; y++){
+            // Filter the original rows up to the bottom of the kernel before they get overwritten.
+            int last = y + pad < r1 ? y + pad : r1-1;
+            for (; loaded <= last; loaded++) __hfilter(p, k, loaded, in, ring + (loaded % R)*len);
+
+            for (int i = -k->r; i <= k->r; i++){
+                int yy = y + i*k->step;
+                yy = yy < 0 ? 0 : yy; yy = yy >= H ? H-1 : yy; // Replicate the edge rows.
+                if (yy < r0) tap[i + k->r] = halo + (yy - r0 + pad)*len;
+                else if (yy >= r1) tap[i + k->r] = halo + (pad + yy - r1)*len;
+                else tap[i + k->r] = ring + (yy % R)*len;
+            }
+
+            // Work through the row in tiles so the output stays in cache while all taps are added.
+            for (long j = 0; j < len; j += __TILE*__CH){
+                int n = len - j < __TILE*__CH ? ( int ) (len - j) : __TILE*__CH;
+                for (int i = 0; i <= 2*k->r; i++) chunk[i] = tap[i] + j;
+                __conv_taps(out + j, chunk, k->k, k->r, n);
+            }
+            if (a->row != NULL) a->row(a->ctx, y, out);
+            else __store(p, y, 0, W, out);
+        }
+    }
+
+    free(ring); free(in); free(out);
+}
+
+/// @brief Convolves the plane, split in row bands over threads.
+/// @param row Handles each convolved row, NULL convolves the plane in place.
+/// @return -1 if allocation failed, 0 otherwise.
+int __convolve_rows (__plane * p, __kernel const * k, __row_fn row, void * ctx){
+    __conv_args a = {p, k, row, ctx, n_threads(), NULL, 0};
+    if (a.bands > p->height) a.bands = p->height;
+    a.halo = ( float ** ) calloc(a.bands, sizeof(float *));
+    if (a.halo == NULL) return -1; // Malloc failed.
+
+    run_bands(__conv_halo, &a, a.bands); // All halos are filtered before any band is written.
+    if (!a.err) run_bands(__conv_bands, &a, a.bands);
+
+    for (int b = 0; b < a.bands; b++) free(a.halo[b]);
+    free(a.halo);
+    return a.err;
+}
+
+/// @brief Convolves the plane in place, split in row bands over threads.
+/// @return -1 if allocation failed, 0 otherwise.
+int __convolve (__plane * p, __kernel const * k){
+    return __convolve_rows(p, k, NULL, NULL);
+}
+
+/// @brief Blurs all channels of the picture in place with a separable Gaussian kernel.
+/// @param sigma Standard deviation of the kernel in pixels, nothing is done if it isn't positive.
+/// @return -1 if allocation failed, 0 otherwise.
+int gaussian_blur (picture * img, double sigma){
+    if (sigma <= 0.0) return 0;
+
+    int r = ( int ) ceil(3.0 * sigma); // Covers 99.7 % of the kernel.
+    float * w = ( float * ) malloc((r+1) * sizeof(float));
+    if (w == NULL) return -1; // Malloc failed.
+
+    double s = 0.0;
+    for (int i = 0; i <= r; i++){
+        w[i] = ( float ) exp(-( double ) (i*i) / (2.0 * sigma*sigma));
+        s += i ? 2.0 * w[i] : w[i];
+    }
+    for (int i = 0; i <= r; i++) w[i] /= ( float ) s; // Normalise so the brightness is kept.
+
+    __plane p = {img->data, NULL, img->width, img->height};
+    __kernel k = {w, r, 1};
+    int err = __convolve(&p, &k);
+
+    free(w);
+    return err;
+}
+
+/// @brief Smooths the picture in place with a Gaussian matching the star profile, this boosts faint stars above the noise before detection.
+/// @param FWHM Expected star FWHM in pixels.
+/// @return -1 if allocation failed, 0 otherwise.
+int matched_filter (picture * img, double FWHM){
+    return gaussian_blur(img, FWHM / (2.0 * sqrt(2.0 * log(2.0)))); // Convert FWHM to standard deviation.
+}
+
+/// @brief Adds the scaled difference between the picture and its blurred copy to a band of rows.
+void __apply_unsharp (void * arg, int start, int end){
+    __pix_args * a = ( __pix_args * ) arg;
+    long from = ( long ) start * a->img->width * __CH, to = ( long ) end * a->img->width * __CH;
+    float amount = ( float ) a->amount;
+
+    for (long j = from; j < to; j++){
+        float v = ( float ) a->img->data[j], b = ( float ) a->blur[j];
+        v += amount * (v - b) + 0.5f;
+        v = v < 0.0f ? 0.0f : v; v = v > 65535.0f ? 65535.0f : v;
+        a->img->data[j] = ( unsigned short ) v;
+    }
+}
+
+/// @brief Sharpens the picture in place by adding the difference with a blurred copy.
+/// @param sigma Standard deviation of the blur in pixels.
+/// @param amount Strength of the sharpening, 0 leaves the picture as is.
+/// @return -1 if allocation failed, 0 otherwise.
+int unsharp_mask (picture * img, double sigma, double amount){
+    long size = ( long ) img->width * img->height * __CH;
+    unsigned short * blur = ( unsigned short * ) malloc(size * sizeof(unsigned short));
+    if (blur == NULL) return -1; // Malloc failed.
+    memcpy(blur, img->data, size * sizeof(unsigned short));
+
+    picture copy = *img; copy.data = blur;
+    if (gaussian_blur(&copy, sigma) == -1) { free(blur); return -1; }
+
+    __pix_args a = {0}; a.img = img; a.blur = blur; a.amount = amount;
+    run_bands(__apply_unsharp, &a, img->height);
+
+    free(blur);
+    return 0;
+}
+
+/// @brief Converts a band of rows of the picture to floats.
+void __to_float (void * arg, int start, int end){
+    __pix_args * a = ( __pix_args * ) arg;
+    long from = ( long ) start * a->img->width * __CH, to = ( long ) end * a->img->width * __CH;
+    for (long j = from; j < to; j++) a->c[j] = ( float ) a->img->data[j];
+}
+
+/// @brief Turns a band of rows of the detail plane from the previous smooth plane into the difference with the current one.
+void __detail (void * arg, int start, int end){
+    __pix_args * a = ( __pix_args * ) arg;
+    long from = ( long ) start * a->img->width * __CH, to = ( long ) end * a->img->width * __CH;
+    for (long j = from; j < to; j++) a->w[j] -= a->c[j];
+}
+
+/// @brief Adds up the absolute detail values of a convolved row of the smooth plane per channel, to estimate the noise. The smooth plane is left as is.
+void __sum_layer (void * ctx, int y, float const * out){
+    __pix_args * a = ( __pix_args * ) ctx;
+    int W = a->img->width;
+    float const * c = a->c + ( long ) y*W*__CH;
+
+    double s [4] = {0.0, 0.0, 0.0, 0.0};
+    for (int x = 0; x < W; x++) for (int ch = 0; ch < __CH; ch++) s[ch] += fabsf(c[x*__CH + ch] - out[x*__CH + ch]);
+    for (int ch = 0; ch < __CH; ch++) a->sums[y*__CH + ch] = s[ch];
+}
+
+/// @brief Adds the scaled and thresholded detail of a convolved row of the smooth plane to the sum of the layers, then stores the row.
+void __apply_layer (void * ctx, int y, float const * out){
+    __pix_args * a = ( __pix_args * ) ctx;
+    int W = a->img->width;
+    float * c = a->c + ( long ) y*W*__CH, * w = a->w + ( long ) y*W*__CH;
+
+    for (int x = 0; x < W; x++) for (int ch = 0; ch < __CH; ch++){
+        int j = x*__CH + ch;
+        float d = c[j] - out[j], t = fabsf(d) - a->thres[ch];
+        t = t > 0.0f ? copysignf(t, d) : 0.0f; // Soft threshold.
+        w[j] += a->gain * t;
+        c[j] = out[j];
+    }
+}
+
+/// @brief Writes the residual plus the sum of the layers to a band of rows of the picture, rounding and clamping once.
+void __from_layers (void * arg, int start, int end){
+    __pix_args * a = ( __pix_args * ) arg;
+    long from = ( long ) start * a->img->width * __CH, to = ( long ) end * a->img->width * __CH;
+
+    for (long j = from; j < to; j++){
+        float v = a->c[j] + a->w[j] + 0.5f;
+        v = v < 0.0f ? 0.0f : v; v = v > 65535.0f ? 65535.0f : v;
+        a->img->data[j] = ( unsigned short ) v;
+    }
+}
+
+/// @brief Splits the picture into detail layers with the a trous wavelet transform. (B3 spline)
+/// @param layers Number of detail layers, layer j holds structures around 2^j pixels in size.
+/// @param w Should hold layers+1 arrays of width*height*4 floats, the last one receives the smooth residual. Adding all of them gives back the picture.
+/// @return -1 if allocation failed, 0 otherwise.
+int wavelet_decompose (picture * img, int layers, float * w []){
+    long size = ( long ) img->width * img->height * __CH;
+    __pix_args a = {0}; a.img = img; a.c = w[layers]; // Smooth in the residual array, no scratch needed.
+    run_bands(__to_float, &a, img->height);
+
+    __plane p = {NULL, a.c, img->width, img->height};
+    for (int j = 0; j < layers; j++){
+        __kernel k = {__B3, 2, 1 << j};
+        memcpy(w[j], a.c, size * sizeof(float));
+        if (__convolve(&p, &k) == -1) return -1;
+
+        a.w = w[j];
+        run_bands(__detail, &a, img->height);
+    }
+
+    return 0;
+}
+
+/// @brief Sharpens and/or denoises the picture in place by scaling and thresholding its wavelet layers.
+/// @param layers Number of detail layers to process.
+/// @param gain Multiplier per layer, above 1 sharpens and below 1 softens. NULL leaves all layers at 1.
+/// @param noise Soft threshold per layer in estimated noise standard deviations, 0 disables it. NULL disables denoising.
+/// @return -1 if allocation failed, 0 otherwise.
+int wavelet_filter (picture * img, int layers, double const gain [], double const noise []){
+    long size = ( long ) img->width * img->height * __CH;
+    float * c = ( float * ) malloc(size * sizeof(float)), * w = ( float * ) calloc(size, sizeof(float));
+    double * sums = ( double * ) malloc(img->height * __CH * sizeof(double));
+    if (c == NULL || w == NULL || sums == NULL) { free(c); free(w); free(sums); return -1; } // Malloc failed.
+
+    __pix_args a = {0}; a.img = img; a.c = c; a.w = w; a.sums = sums;
+    run_bands(__to_float, &a, img->height);
+
+    // The picture is the residual plus all layers, so the processed layers are summed in w and only the smooth plane is kept.
+    // Each layer is the difference between the smooth plane before and after a convolution, it is taken as the rows are convolved.
+    __plane p = {NULL, c, img->width, img->height};
+    int err = 0;
+    for (int j = 0; j < layers && !err; j++){
+        __kernel k = {__B3, 2, 1 << j};
+
+        a.gain = gain != NULL ? ( float ) gain[j] : 1.0f;
+        for (int ch = 0; ch < __CH; ch++) a.thres[ch] = 0.0f;
+        if (noise != NULL && noise[j] > 0.0){ // The threshold needs the whole layer, so it is convolved once more just to sum it.
+            if (__convolve_rows(&p, &k, __sum_layer, &a) == -1) { err = -1; break; }
+            for (int ch = 0; ch < __CH; ch++){
+                double s = 0.0;
+                for (int y = 0; y < img->height; y++) s += sums[y*__CH + ch];
+                double sigma = s / (( double ) img->width * img->height) * sqrt(M_PI / 2.0); // Mean absolute deviation to standard deviation, assuming Gaussian noise.
+                a.thres[ch] = ( float ) (noise[j] * sigma);
+            }
+        }
+        if (__convolve_rows(&p, &k, __apply_layer, &a) == -1) err = -1;
+    }
+    if (!err) run_bands(__from_layers, &a, img->height); // Round once, the picture is left as is if the filter failed.
+
+    free(c); free(w); free(sums);
+    return err;
+}
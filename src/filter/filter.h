@@ -0,0 +1,39 @@
+# ifndef FILTER_H__
+# define FILTER_H__
+
+# include <stdlib.h>
+# include <string.h>
+# include <math.h>
+
+# include "../stardet/stardet.h"
+
+/// @brief Blurs all channels of the picture in place with a separable Gaussian kernel.
+/// @param sigma Standard deviation of the kernel in pixels, nothing is done if it isn't positive.
+/// @return -1 if allocation failed, 0 otherwise.
+int gaussian_blur (picture * img, double sigma);
+
+/// @brief Smooths the picture in place with a Gaussian matching the star profile, this boosts faint stars above the noise before detection.
+/// @param FWHM Expected star FWHM in pixels.
+/// @return -1 if allocation failed, 0 otherwise.
+int matched_filter (picture * img, double FWHM);
+
+/// @brief Sharpens the picture in place by adding the difference with a blurred copy.
+/// @param sigma Standard deviation of the blur in pixels.
+/// @param amount Strength of the sharpening, 0 leaves the picture as is.
+/// @return -1 if allocation failed, 0 otherwise.
+int unsharp_mask (picture * img, double sigma, double amount);
+
+/// @brief Splits the picture into detail layers with the a trous wavelet transform. (B3 spline)
+/// @param layers Number of detail layers, layer j holds structures around 2^j pixels in size.
+/// @param w Should hold layers+1 arrays of width*height*4 floats, the last one receives the smooth residual. Adding all of them gives back the picture.
+/// @return -1 if allocation failed, 0 otherwise.
+int wavelet_decompose (picture * img, int layers, float * w []);
+
+/// @brief Sharpens and/or denoises the picture in place by scaling and thresholding its wavelet layers.
+/// @param layers Number of detail layers to process.
+/// @param gain Multiplier per layer, above 1 sharpens and below 1 softens. NULL leaves all layers at 1.
+/// @param noise Soft threshold per layer in estimated noise standard deviations, 0 disables it. NULL disables denoising.
+/// @return -1 if allocation failed, 0 otherwise.
+int wavelet_filter (picture * img, int layers, double const gain [], double const noise []);
+
+# endif
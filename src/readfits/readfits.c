@@ -3,34 +3,9 @@
 char const * __BAYERPAT = "BAYERPAT";
 char const * __END      = "END     ";
 
-/// @brief Places the file pointer at the start of the data array.
-/// @return -1 if the END keyword cannot be found or file ended preemptively, 0 otherwise.
-int goto_end (FILE * fptr){
-    int read_counter = 0, endbool;
-    char c;
-
-    while (1) {
-        endbool = 1;
-        for (int i = 0; i < 8; i++){ // Read keyword.
-            c = fgetc(fptr);
-            if (c == EOF) return -1;
-            if (c != __END[i]) endbool = 0;
-        }
-        for (int i = 8; i < 80; i++) if (fgetc(fptr) == EOF) return -1; // Clear the lagging " "'s after keyword.
-
-        read_counter++; // Increment amount of chunks we have read.
-        read_counter = read_counter % 36; // Go back to 0 after block of 36 keyvals has ended.
-
-        if (!endbool) continue; // Did not reach end.
-
-        for (int i = read_counter; i < 36; i++) // Loop through remaining blocks in HDU.
-            for (int j = 0; j < 80; j++) // Loop through block.
-                if (fgetc(fptr) == EOF) return -1; // Clear the remaining " "'s.
-        break;
-    }
-
-    return 0;
-}
+// Some constants.
+int const __BLOCK = 2880, // FITS files are split in blocks of this many bytes.
+__MAX_AXES = 999; // Maximum number of axes allowed by the FITS standard.
 
 /// @brief Finds the given keyword.
 /// @return -1 if keyword cannot be found, 0 otherwise.
@@ -96,18 +71,101 @@ float read_keyval (FILE * fptr, char const keyword [9]){
     return ret;
 }
 
-/// @brief Extract bayer pattern from file.
-/// @param bayer String to store bayer pattern.
-/// @return -1 if BAYERPAT keyword cannot be found, 0 otherwise.
-int read_bayer (FILE * fptr, char bayer [5]){
-    long start = ftell(fptr); fseek(fptr, 0, SEEK_SET);
+/// @brief Copies the quoted string value of a card without trailing spaces.
+/// @param n Maximum number of characters to copy, str should have room for one more.
+void __read_string (char const * val, char str [], int n){
+    int i = 0;
+    char const * q = strchr(val, '\''); // Value is a quoted string.
+    if (q != NULL) for (q++; i < n && q[i] != '\'' && q[i] != '\0'; i++) str[i] = q[i];
+    while (i > 0 && str[i-1] == ' ') i--;
+    str[i] = '\0';
+}
+
+/// @brief Stores the value of a header card in the HDU if its keyword is one we use.
+/// @param axes Stores the NAXISn values here.
+/// @param groups Set to 1 if the data is in the random groups format.
+void __parse_card (char const card [81], hdu * h, long axes [], long * pcount, long * gcount, int * groups){
+    if (card[8] != '=') return; // Card has no value.
+    char const * val = card + 10;
+
+    if (!strncmp(card, "BITPIX  ", 8)) h->bitpix = atoi(val);
+    else if (!strncmp(card, "NAXIS   ", 8)) h->naxis = atoi(val);
+    else if (!strncmp(card, "NAXIS", 5) && '0' <= card[5] && card[5] <= '9'){ // NAXISn keyword.
+        int n = atoi(card + 5);
+        if (1 <= n && n <= __MAX_AXES) axes[n-1] = atol(val);
+    }
+    else if (!strncmp(card, "PCOUNT  ", 8)) *pcount = atol(val);
+    else if (!strncmp(card, "GCOUNT  ", 8)) *gcount = atol(val);
+    else if (!strncmp(card, "BZERO   ", 8)) h->bzero = strtod(val, NULL);
+    else if (!strncmp(card, "GROUPS  ", 8)) *groups = strchr(val, 'T') != NULL;
+    else if (!strncmp(card, "XTENSION", 8)) __read_string(val, h->xtension, 8);
+    else if (!strncmp(card, __BAYERPAT, 8)) __read_string(val, h->bayer, 4);
+}
+
+/// @brief Rounds a size up to a whole number of FITS blocks.
+long __pad_block (long size){
+    return (size + __BLOCK - 1) / __BLOCK * __BLOCK;
+}
+
+/// @brief Indexes every HDU in the file, including image extensions.
+/// @param hdus Stores a newly allocated array of HDUs here, should be freed by the caller.
+/// @return Number of HDUs; -1 if the file is invalid, -3 if allocation failed.
+int index_fits (FILE * fptr, hdu ** hdus){
+    long start = ftell(fptr), pos = 0, axes [__MAX_AXES];
+    int N = 0, cap = 4, err = 0;
+    char card [81]; card[80] = '\0';
 
-    if (__find_keyword(fptr, __BAYERPAT) == -1) return -1;
+    *hdus = ( hdu * ) malloc(cap * sizeof(hdu));
+    if (*hdus == NULL) return -3; // Malloc failed.
 
-    fgetc(fptr); fgetc(fptr); fgetc(fptr); // Clear the leading "= '".
-    fgets(bayer, 5, fptr); // Read bayer pattern.
-    for (int i = 5; i < 70; i++) fgetc(fptr); // Clear the lagging " "'s.
+    while (1){
+        if (fseek(fptr, pos, SEEK_SET) != 0 || fread(card, 1, 80, fptr) != 80) break; // No more HDUs.
+        if (N == 0 && strncmp(card, "SIMPLE  ", 8)) { err = -1; break; } // Not a FITS file.
+        if (N > 0 && strncmp(card, "XTENSION", 8)) break; // Special records after the last HDU.
+
+        hdu h = {0}; long pcount = 0, gcount = 1; int cards = 1, groups = 0;
+        h.header = pos;
+        for (int i = 0; i < __MAX_AXES; i++) axes[i] = 0;
+        __parse_card(card, &h, axes, &pcount, &gcount, &groups); // Extension type.
+
+        // Read cards up to the END keyword.
+        while (1){
+            if (fread(card, 1, 80, fptr) != 80) { err = -1; break; } // Header ended preemptively.
+            cards++;
+            if (!strncmp(card, __END, 8)) break;
+            __parse_card(card, &h, axes, &pcount, &gcount, &groups);
+        }
+        if (err) break;
+
+        long n = h.naxis > 0 ? 1 : 0; // Number of values in the data array.
+        for (int i = groups ? 1 : 0; i < h.naxis && i < __MAX_AXES; i++) n *= axes[i]; // NAXIS1 is 0 for random groups.
+        h.data = pos + __pad_block(( long ) cards * 80);
+        h.size = ( long ) abs(h.bitpix) / 8 * gcount * (pcount + n);
+
+        // Only the primary array and image extensions hold images, tables and random groups don't.
+        int image = !groups && (N == 0 || !strcmp(h.xtension, "IMAGE")) && h.naxis >= 2;
+        for (int i = 0; i < h.naxis && i < __MAX_AXES; i++) if (axes[i] <= 0) image = 0; // Empty axis.
+        if (image){
+            h.width = ( int ) axes[0]; h.height = ( int ) axes[1]; h.planes = 1;
+            for (int i = 2; i < h.naxis && i < __MAX_AXES; i++) h.planes *= axes[i];
+        }
+
+        if (N == cap){ // Make room for the next HDU.
+            hdu * tmp = ( hdu * ) realloc(*hdus, 2 * cap * sizeof(hdu));
+            if (tmp == NULL) { err = -3; break; } // Realloc failed.
+            *hdus = tmp; cap *= 2;
+        }
+        (*hdus)[N++] = h;
+        pos = h.data + __pad_block(h.size); // Next header starts after the padded data.
+    }
 
     fseek(fptr, start, SEEK_SET); // Go back to starting position
-    return 0;
+    if (err) { free(*hdus); *hdus = NULL; return err; }
+    return N;
+}
+
+/// @brief Calculates the offset of a plane of a data cube from the header.
+/// @return The offset of the first value of the plane.
+long plane_offset (hdu const * h, long plane){
+    return h->data + plane * h->width * h->height * (abs(h->bitpix) / 8);
 }
@@ -2,19 +2,36 @@
 # define READFITS_H__
 
 # include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
 # include <math.h>
 
-/// @brief Places the file pointer at the start of the data array.
-/// @return -1 if the END keyword cannot be found or file ended preemptively, 0 otherwise.
-int goto_end (FILE * fptr);
+// Header and data unit of a FITS file.
+typedef struct {
+    char xtension [9]; // Extension type, eg. "IMAGE" or "BINTABLE". Empty for the primary HDU.
+    long header; // Offset of the header.
+    long data; // Offset of the data array.
+    long size; // Size of the data array in bytes, without padding.
+    int bitpix; // Bits per value, negative for floating point.
+    int naxis; // Number of axes.
+    int width; // NAXIS1, 0 if the HDU holds no image.
+    int height; // NAXIS2, 0 if the HDU holds no image.
+    long planes; // Number of width by height planes, the product of all axes after the second. 0 if the HDU holds no image.
+    double bzero; // Offset from stored to physical values.
+    char bayer [5]; // Bayer pattern, empty if there is none.
+} hdu;
 
 /// @brief Reads the value of the given keyword.
 /// @return This value; NAN if the keyword cannot be found.
 float read_keyval (FILE * fptr, char const keyword [9]);
 
-/// @brief Extract bayer pattern from file.
-/// @param bayer String to store bayer pattern.
-/// @return -1 if BAYERPAT keyword cannot be found, 0 otherwise.
-int read_bayer (FILE * fptr, char bayer [5]);
+/// @brief Indexes every HDU in the file, including image extensions.
+/// @param hdus Stores a newly allocated array of HDUs here, should be freed by the caller.
+/// @return Number of HDUs; -1 if the file is invalid, -3 if allocation failed.
+int index_fits (FILE * fptr, hdu ** hdus);
+
+/// @brief Calculates the offset of a plane of a data cube from the header.
+/// @return The offset of the first value of the plane.
+long plane_offset (hdu const * h, long plane);
 
 # endif
@@ -1,4 +1,9 @@
 # include "stardet.h"
+# include "../threads/threads.h"
+
+# ifdef __SSE2__
+# include <emmintrin.h>
+# endif
 
 # ifndef M_PI
 # define M_PI 3.14159265358979323846
@@ -7,7 +12,17 @@
 // Some constants.
 int const __FIND_MIDDLE_ITER = 3, // Number of iterations to find star center.
 __STAR_MARGIN = 50, // Maximum star size.
-__RAYS = 10; // Number of rays to find major/minor axis. (should ALWAYS be even so there can be a minor/major pair)
+__RAYS = 10, // Number of rays to find major/minor axis. (should ALWAYS be even so there can be a minor/major pair)
+__GRID_CELL = 64; // Cell size in pixels of the grid used to look up nearby stars.
+
+// Coarse grid of star indices, a star is listed in every cell its exclusion zone overlaps.
+typedef struct {
+    int cols; // Number of cells per row.
+    int rows; // Number of cell rows.
+    int * N; // Number of stars per cell.
+    int * cap; // Room for stars per cell.
+    int ** idx; // Star indices per cell.
+} __star_grid;
 
 /// @brief RGB to monochrome conversion function. (CIE 1931)
 int __RGB_to_mono (int R, int G, int B){
@@ -29,6 +44,7 @@ signed short __endian_swap (unsigned short in){
 void __close (picture * img, int arr){
     fclose(img->file);
     if (arr) free(img->data);
+    free(img->hdus); img->hdus = NULL; img->N_hdus = 0;
 }
 
 /// @brief Round function.
@@ -57,40 +73,20 @@ int __check_PGM (char const * path){
     return -1; // Not PGM or FITS: invalid file type.
 }
 
-/// @brief Reads the width, height and maximum pixel value.
+/// @brief Reads the width, height and maximum pixel value of a PGM file.
 /// @return -1 if file is invalid, 0 otherwise.
 int __read_metadata (picture * img){
-    if (img->PGM){
-        if (fgetc(img->file) != 'P' || fgetc(img->file) != '5') return -1; fgetc(img->file); // Check PGM for validity.
-        fscanf(img->file, "%d %d", &img->width, &img->height);
-        fscanf(img->file, "%d", &img->max);
-        return 0;
-    }
-
-    if (read_keyval(img->file, "SIMPLE  ") != ( float ) 'T') return -1; // Check FITS for validity.
-
-    img->width = ( int ) read_keyval(img->file, "NAXIS1  ");
-    img->height = ( int ) read_keyval(img->file, "NAXIS2  ");
-    img->max = (1 << ( int ) read_keyval(img->file, "BITPIX  ")) - 1;
-
+    if (fgetc(img->file) != 'P' || fgetc(img->file) != '5') return -1; fgetc(img->file); // Check PGM for validity.
+    fscanf(img->file, "%d %d", &img->width, &img->height);
+    fscanf(img->file, "%d", &img->max);
     return 0;
 }
 
-/// @brief Converts raw FITS data to physical data and debayers the FITS file if it has a Bayer pattern.
+/// @brief Debayers the picture by averaging the colours in each pixels neighbourhood.
 /// @return -1 if malloc failed, 0 otherwise.
-int __debayer (picture * img){
-    int bias = ( int ) read_keyval(img->file, "BZERO   "), mono = 0;
-    char bayer [5]; if (read_bayer(img->file, bayer) == -1) mono = 1; // Monochrome file handling.
+int __debayer (picture * img, char const bayer [5]){
     img->avg = 0.0; // Recalculate average.
 
-    for (int row = 0; row < img->height; row++) for (int col = 0; col < img->width; col++){
-        img->data[row*img->width*4 + col*4] = bias + __endian_swap(img->data[row*img->width*4 + col*4]); // Convert raw data to physical value.
-        img->avg += img->data[row*img->width*4 + col*4];
-    }
-    img->avg /= ( double ) (img->width * img->height);
-    if (mono) return 0;
-    img->avg = 0.0; // Recalculate average again.
-
     // Interpolation.
     unsigned short * buf = ( unsigned short * ) malloc(img->height * img->width * 4 * sizeof(unsigned short)); // Allocate a buffer for debayered image.
     if (buf == NULL) return -1; // Malloc failed.
@@ -126,16 +122,79 @@ int __debayer (picture * img){
     return 0;
 }
 
+/// @brief Reads a single plane of a FITS HDU into a given picture struct, converting to physical values and debayering if needed.
+/// @param h Should come from index_fits on the same file.
+/// @param plane Index of the plane, 0 for 2-D images.
+/// @return -2 if the HDU has no such plane, -3 if allocation failed, -4 if the file ended preemptively, -5 if the BITPIX is unsupported, 0 otherwise.
+int read_plane (FILE * fptr, hdu const * h, long plane, picture * img){
+    if (plane < 0 || plane >= h->planes) return -2; // No such plane.
+    if (h->bitpix != 8 && h->bitpix != 16) return -5; // Only 8 and 16 bit integer data is supported.
+
+    int bytepix = h->bitpix / 8;
+    long N = ( long ) h->width * h->height;
+    img->width = h->width; img->height = h->height;
+    img->max = (1 << h->bitpix) - 1; img->PGM = 0;
+
+    unsigned char * raw = ( unsigned char * ) malloc(N * bytepix); // Whole plane in one read instead of one read per pixel.
+    img->data = ( unsigned short * ) malloc(N * 4 * sizeof(unsigned short));
+    if (raw == NULL || img->data == NULL) { free(raw); free(img->data); img->data = NULL; return -3; } // Malloc failed.
+
+    if (fseek(fptr, plane_offset(h, plane), SEEK_SET) != 0 || fread(raw, bytepix, N, fptr) != ( size_t ) N){
+        free(raw); free(img->data); img->data = NULL; return -4; // EOF reached.
+    }
+
+    // Convert raw data to physical values.
+    img->avg = 0.0;
+    for (long i = 0; i < N; i++){
+        double v = h->bzero + (bytepix == 2 ? ( double ) __endian_swap((( unsigned short * ) raw)[i]) : ( double ) raw[i]);
+        v = v < 0.0 ? 0.0 : v; v = v > img->max ? img->max : v;
+        for (int c = 0; c < 4; c++) img->data[i*4 + c] = ( unsigned short ) v; // Grey until debayered.
+        img->avg += v;
+    }
+    img->avg /= ( double ) N;
+    free(raw);
+
+    if (h->bayer[0] != '\0' && __debayer(img, h->bayer) == -1){ // Debayer (only if plane has a Bayer pattern).
+        free(img->data); img->data = NULL; return -3; // Malloc failed.
+    }
+
+    return 0;
+}
+
+/// @brief Indexes a FITS file into img->hdus and reads its first supported image, which is in an extension if the primary HDU has no data.
+/// @return -2 if file invalid, -3 if allocation failed, -4 if the file ended preemptively, -5 if no image has a supported BITPIX, 0 otherwise.
+int __read_fits (picture * img){
+    int N = index_fits(img->file, &img->hdus), err = -2;
+    if (N == -3) return -3; // Malloc failed.
+    if (N <= 0) return -2; // Invalid file.
+    img->N_hdus = N;
+
+    for (int i = 0; i < N; i++){ // Skip HDUs without an image or in a format we can't read, eg. floating point.
+        if (img->hdus[i].planes == 0) continue;
+        int e = read_plane(img->file, &img->hdus[i], 0, img);
+        if (e != -5) return e;
+        err = -5;
+    }
+    return err;
+}
+
 /// @brief Reads the contents of a file into a given picture struct.
 /// @param path Should have .pgm or .fits extension.
 /// @param RGB_to_mono RGB to monochrome conversion function.
-/// @return -1 if path invalid, -2 if file invalid, -3 if allocation failed, 0 otherwise.
+/// @return -1 if path invalid, -2 if file invalid, -3 if allocation failed, -4 if the file ended preemptively, -5 if the image format is unsupported, 0 otherwise.
 int read_starfile (char const * path, picture * img){
+    img->hdus = NULL; img->N_hdus = 0;
     img->file = fopen(path, "rb");
     if (img->file == NULL) return -1; // Invalid path.
     img->PGM = __check_PGM(path); // Check if file is PGM or FITS type.
     if (img->PGM == -1){ __close(img, 0); return -2; } // Invalid file extension.
 
+    if (!img->PGM){ // FITS files are read plane wise.
+        int err = __read_fits(img);
+        if (err) __close(img, 0);
+        return err;
+    }
+
     // Get metadata.
     if (__read_metadata(img) == -1){
         __close(img, 0); return -2; // Invalid file.
@@ -143,9 +202,6 @@ int read_starfile (char const * path, picture * img){
     int temp = img->max + 1, i; for (i = 0; temp > 1; i++) temp = temp >> 1; int bytepix = i >> 3; // Determine bytes per pixelvalue.
 
     // Get data.
-    if (!img->PGM && goto_end(img->file) == -1){
-        __close(img, 0); return -2; // Invalid file.
-    }
     img->data = ( unsigned short * ) malloc(img->height * img->width * 4 * sizeof(unsigned short)); // Allocate row array.
     if (img->data == NULL) { __close(img, 0); return -3; } // Malloc failed.
     for (int row = 0; row < img->height; row++){
@@ -160,26 +216,151 @@ int read_starfile (char const * path, picture * img){
     }
     img->avg /= ( double ) (img->width*img->height);
 
-    if (!img->PGM && __debayer(img) == -1) // Debayer (only if file is FITS type).
-        return -3; // Malloc failed.
+    return 0;
+}
+
+// Arguments shared by the threads building a mask.
+typedef struct {
+    picture * img; // Picture to compare to its threshold.
+    thres_mask * mask; // Mask to fill.
+} __mask_args;
+
+/// @brief Compares up to 64 pixels to the threshold.
+/// @param px First pixel, mono values are 4 apart.
+/// @param n Number of pixels, at most 64.
+/// @return A word with bit i set if pixel i is above the threshold.
+unsigned long long __mask_word (unsigned short const * px, int n, int thres){
+    unsigned long long bits = 0;
+    int i = 0;
+
+# ifdef __SSE2__
+    if (thres >= 0 && thres < 65535){
+        __m128i t = _mm_set1_epi16(( short ) thres), zero = _mm_setzero_si128();
+        for (; i + 4 <= n; i += 4){ // 4 pixels per step, 2 per vector.
+            __m128i a = _mm_loadu_si128(( __m128i const * ) (px + i*4)), b = _mm_loadu_si128(( __m128i const * ) (px + i*4 + 8));
+            a = _mm_cmpeq_epi16(_mm_subs_epu16(a, t), zero); b = _mm_cmpeq_epi16(_mm_subs_epu16(b, t), zero); // All ones if not above the threshold.
+            unsigned int m = ~_mm_movemask_epi8(_mm_packs_epi16(a, b)) & 0x1111; // Mono values end up at bits 0, 4, 8 and 12.
+            m = (m | m >> 3) & 0x0303; m = (m | m >> 6) & 0x000f; // Gather them into the lowest 4 bits.
+            bits |= ( unsigned long long ) m << i;
+        }
+    }
+# endif
+
+    for (; i < n; i++) bits |= ( unsigned long long ) (px[i*4] > thres) << i; // Leftover pixels.
+
+    return bits;
+}
+
+/// @brief Fills the mask for a band of rows.
+void __mask_rows (void * arg, int start, int end){
+    __mask_args * a = ( __mask_args * ) arg;
+    picture * img = a->img; thres_mask * mask = a->mask;
+
+    for (int row = start; row < end; row++){
+        unsigned long long any = 0, * bits = mask->bits + ( long ) row*mask->words;
+        for (int w = 0; w < mask->words; w++){
+            int col = w*64, n = img->width - col < 64 ? img->width - col : 64;
+            bits[w] = __mask_word(img->data + (( long ) row*img->width + col)*4, n, img->thres);
+            any |= bits[w];
+        }
+        mask->rows[row] = any != 0;
+    }
+}
+
+/// @brief Marks the pixels above img->thres in a newly allocated mask.
+/// @param img Should be run through the "read" function first.
+/// @return -1 if allocation failed, 0 otherwise.
+int build_thres_mask (picture * img, thres_mask * mask){
+    mask->width = img->width; mask->height = img->height;
+    mask->words = (img->width + 63) / 64;
+    mask->bits = ( unsigned long long * ) malloc(( long ) mask->words * img->height * sizeof(unsigned long long));
+    mask->rows = ( unsigned char * ) malloc(img->height);
+    if (mask->bits == NULL || mask->rows == NULL) { free_thres_mask(mask); return -1; } // Malloc failed.
+
+    __mask_args a = {img, mask};
+    run_bands(__mask_rows, &a, img->height);
 
     return 0;
 }
 
+/// @brief Checks if a pixel is above the threshold of the mask.
+/// @return 1 if it is, 0 otherwise.
+int thres_mask_get (thres_mask const * mask, int x, int y){
+    return (mask->bits[( long ) y*mask->words + x/64] >> (x % 64)) & 1;
+}
+
+/// @brief Frees the arrays of a mask.
+void free_thres_mask (thres_mask * mask){
+    free(mask->bits); free(mask->rows);
+    mask->bits = NULL; mask->rows = NULL;
+}
+
 /// @brief Checks if a bright pixel is part of a potential star.
 /// @return 1 if it is, 0 otherwise.
-int __potential_star (picture * img, int x, int y){
-    if (x+1 >= img->width || y+1 >= img->height) return 0; // Cut-off star or noise at the edge of the image.
-    if (img->data[(y+1)*img->width*4 + x*4] > img->thres || img->data[y*img->width*4 + (x+1)*4] > img->thres) return 1; // Star.
+int __potential_star (thres_mask const * mask, int x, int y){
+    if (x+1 >= mask->width || y+1 >= mask->height) return 0; // Cut-off star or noise at the edge of the image.
+    if (thres_mask_get(mask, x, y+1) || thres_mask_get(mask, x+1, y)) return 1; // Star.
     return 0; // Noise.
 }
 
+/// @brief Allocates an empty grid covering the image.
+/// @return -1 if allocation failed, 0 otherwise.
+int __grid_init (__star_grid * g, int width, int height){
+    g->cols = (width + __GRID_CELL-1) / __GRID_CELL; g->rows = (height + __GRID_CELL-1) / __GRID_CELL;
+    g->N = ( int * ) calloc(g->cols * g->rows, sizeof(int));
+    g->cap = ( int * ) calloc(g->cols * g->rows, sizeof(int));
+    g->idx = ( int ** ) calloc(g->cols * g->rows, sizeof(int *));
+    if (g->N == NULL || g->cap == NULL || g->idx == NULL) { free(g->N); free(g->cap); free(g->idx); return -1; } // Malloc failed.
+    return 0;
+}
+
+/// @brief Frees the grid.
+void __grid_free (__star_grid * g){
+    for (int i = 0; i < g->cols * g->rows; i++) free(g->idx[i]);
+    free(g->N); free(g->cap); free(g->idx);
+}
+
+/// @brief Finds the cell a coordinate falls in, clamped to the grid.
+int __grid_cell (double v, int n){
+    double c = floor(v / ( double ) __GRID_CELL);
+    if (!(c >= 0.0)) return 0;
+    if (c >= ( double ) n) return n-1;
+    return ( int ) c;
+}
+
+/// @brief Lists a star in every cell its exclusion zone overlaps.
+/// @return -1 if allocation failed, 0 otherwise.
+int __grid_insert (__star_grid * g, star const * s, int stari){
+    if (!(s->FWHM > 0.0)) return 0; // Can't exclude any pixels.
+    double reach = 2.0*s->FWHM + 1.0; // __compare_star truncates the distance, so it can exclude up to a pixel further.
+
+    int c0 = __grid_cell(s->pos.x - reach, g->cols), c1 = __grid_cell(s->pos.x + reach, g->cols),
+    r0 = __grid_cell(s->pos.y - reach, g->rows), r1 = __grid_cell(s->pos.y + reach, g->rows);
+
+    for (int r = r0; r <= r1; r++) for (int c = c0; c <= c1; c++){
+        int cell = r*g->cols + c;
+        if (g->N[cell] == g->cap[cell]){ // Make room in the cell.
+            int cap = g->cap[cell] ? 2*g->cap[cell] : 4;
+            int * tmp = ( int * ) realloc(g->idx[cell], cap * sizeof(int));
+            if (tmp == NULL) return -1; // Realloc failed.
+            g->idx[cell] = tmp; g->cap[cell] = cap;
+        }
+        g->idx[cell][g->N[cell]++] = stari;
+    }
+
+    return 0;
+}
+
 /// @brief Checks if a bright pixel is not too close to any known stars.
+/// @param g Grid of the known stars, only the ones listed in the pixels cell can be close enough.
 /// @return 0 if it is too close, 1 otherwise.
-int __compare_star (star stars [], int x, int y, int stari){
-    for (int i = 0; i < stari; i++)
+int __compare_star (star stars [], __star_grid const * g, int x, int y){
+    int cell = (y / __GRID_CELL)*g->cols + x / __GRID_CELL;
+    for (int j = 0; j < g->N[cell]; j++){
+        int i = g->idx[cell][j];
         if (( double ) abs(stars[i].pos.x - x) < 2.0*stars[i].FWHM &&
             ( double ) abs(stars[i].pos.y - y) < 2.0*stars[i].FWHM) return 0; // Too close to known stars.
+    }
 
     return 1; // New star.
 }
@@ -350,30 +531,130 @@ double __find_SNR (picture * img, star stars [], int stari){
 }
 
 /// @brief Extracts stars from the given file into the given array.
-/// @param img Should be run through the "read" function first.
-/// @param stars Should be the size of N_stars or bigger.
-/// @param N_stars Maximum number of stars to extract.
-/// @return Number of extracted stars.
-int extract_stars (picture * img, star stars [], int N_stars){
+/// @param N_stars Size of the stars array.
+/// @param grow Reallocate the stars array when it is full y/n.
+/// @return Number of extracted stars; -1 if allocation failed.
+int __extract (picture * img, star ** stars, int * N_stars, int grow){
     int stari = 0; // Current index in stars array
+    thres_mask mask; __star_grid grid;
+    if (build_thres_mask(img, &mask) == -1) return -1; // Find all bright pixels up front
+    if (__grid_init(&grid, img->width, img->height) == -1) { free_thres_mask(&mask); return -1; }
 
     for (int row = 0; row < img->height; row++){
-        for (int col = 0; col < img->width; col++){
-            if (stari != -1 && stari >= N_stars) return N_stars;
-
-            int star_bool = 0;
-            if (img->data[row*img->width*4 + col*4] > img->thres) star_bool = __potential_star(img, col, row); // Check bright pixel is part of a non-cutoff star
-            if (star_bool) star_bool = __compare_star(stars, col, row, stari); // Check if bright pixel is not too close to any extracted stars
-            if (star_bool){
-                if (__find_middle(img, stars, col, row, stari)) continue; // Iteratively find the center of the star
-                stars[stari].e = __find_eccentricity(img, stars, stari); // Find eccentricity of star and major axis incline angle
-                stars[stari].FWHM = sqrt(__find_FWHM(img, stars, stari, 0) * __find_FWHM(img, stars, stari, 1)); // Take geometric mean of FWHM along minor and major axes
-                stars[stari].HFD = sqrt(__find_HFD(img, stars, stari, 0) * __find_HFD(img, stars, stari, 1)); // Take geometric mean of HFD along minor and major axes
-                stars[stari].SNR = __find_SNR(img, stars, stari);
-                stari++;
+        if (!mask.rows[row]) continue; // Only sky in this row
+        for (int w = 0; w < mask.words; w++){
+            unsigned long long bits = mask.bits[( long ) row*mask.words + w];
+            while (bits){ // Visit the bright pixels in order
+                int col = w*64 + __builtin_ctzll(bits);
+                bits &= bits - 1;
+                if (!grow && stari >= *N_stars) { free_thres_mask(&mask); __grid_free(&grid); return *N_stars; }
+
+                int star_bool = __potential_star(&mask, col, row); // Check bright pixel is part of a non-cutoff star
+                if (star_bool) star_bool = __compare_star(*stars, &grid, col, row); // Check if bright pixel is not too close to any extracted stars
+                if (star_bool && stari >= *N_stars){ // Make room for the new star
+                    star * tmp = ( star * ) realloc(*stars, 2 * *N_stars * sizeof(star));
+                    if (tmp == NULL) { free_thres_mask(&mask); __grid_free(&grid); return -1; } // Realloc failed.
+                    *stars = tmp; *N_stars *= 2;
+                }
+                if (star_bool){
+                    star * s = *stars;
+                    if (__find_middle(img, s, col, row, stari)) continue; // Iteratively find the center of the star
+                    s[stari].e = __find_eccentricity(img, s, stari); // Find eccentricity of star and major axis incline angle
+                    s[stari].FWHM = sqrt(__find_FWHM(img, s, stari, 0) * __find_FWHM(img, s, stari, 1)); // Take geometric mean of FWHM along minor and major axes
+                    s[stari].HFD = sqrt(__find_HFD(img, s, stari, 0) * __find_HFD(img, s, stari, 1)); // Take geometric mean of HFD along minor and major axes
+                    s[stari].SNR = __find_SNR(img, s, stari);
+                    if (__grid_insert(&grid, &s[stari], stari) == -1) { free_thres_mask(&mask); __grid_free(&grid); return -1; } // Remember where the star is
+                    stari++;
+                }
             }
         }
     }
 
+    free_thres_mask(&mask); __grid_free(&grid);
     return stari;
 }
+
+/// @brief Extracts stars from the given file into the given array.
+/// @param img Should be run through the "read" function first.
+/// @param stars Should be the size of N_stars or bigger.
+/// @param N_stars Maximum number of stars to extract.
+/// @return Number of extracted stars; -1 if allocation failed.
+int extract_stars (picture * img, star stars [], int N_stars){
+    return __extract(img, &stars, &N_stars, 0);
+}
+
+/// @brief Extracts all stars from the given file into a newly allocated array.
+/// @param img Should be run through the "read" function first.
+/// @param stars Stores the allocated array here, should be freed by the caller.
+/// @return Number of extracted stars; -1 if allocation failed.
+int extract_all_stars (picture * img, star ** stars){
+    int N_stars = 256; // Initial size, doubles whenever it is full.
+    *stars = ( star * ) malloc(N_stars * sizeof(star));
+    if (*stars == NULL) return -1; // Malloc failed.
+
+    int N = __extract(img, stars, &N_stars, 1);
+    if (N == -1) { free(*stars); *stars = NULL; }
+    return N;
+}
+
+
+// Arguments shared by the threads analysing planes.
+typedef struct {
+    char const * path; // File to read the planes from.
+    hdu const * hdus; // HDUs of that file.
+    int (* threshold) (double avg); // Star detection threshold function.
+    plane_result * results; // Results, one per plane.
+} __planes_args;
+
+/// @brief Reads and extracts the stars of a band of planes, each thread reads through its own file pointer.
+void __analyse_planes (void * arg, int start, int end){
+    __planes_args * a = ( __planes_args * ) arg;
+    FILE * fptr = fopen(a->path, "rb");
+
+    for (int i = start; i < end; i++){
+        plane_result * r = &a->results[i];
+        if (fptr == NULL) { r->err = -1; continue; } // Invalid path.
+
+        picture img = {0}; img.file = fptr;
+        r->err = read_plane(fptr, &a->hdus[r->hdu], r->plane, &img);
+        if (r->err) continue;
+
+        r->avg = img.avg;
+        r->thres = img.thres = a->threshold(img.avg);
+        r->N = extract_all_stars(&img, &r->stars);
+        if (r->N == -1) { r->N = 0; r->err = -3; } // Malloc failed.
+        free(img.data);
+    }
+
+    if (fptr != NULL) fclose(fptr);
+}
+
+/// @brief Extracts the stars of every plane of every HDU in a FITS file, planes are split over threads.
+/// @param hdus Should come from index_fits on the same file.
+/// @param threshold Calculates the star detection threshold from the average pixel value of a plane.
+/// @param results Stores a newly allocated array of results here, one per plane in HDU order. Should be freed with free_plane_results.
+/// @return Number of planes; -3 if allocation failed.
+int analyse_planes (char const * path, hdu const hdus [], int N_hdus, int (* threshold) (double avg), plane_result ** results){
+    int N = 0;
+    for (int i = 0; i < N_hdus; i++) N += ( int ) hdus[i].planes;
+
+    *results = ( plane_result * ) calloc(N > 0 ? N : 1, sizeof(plane_result));
+    if (*results == NULL) return -3; // Malloc failed.
+
+    // List every plane so threads can pick them up in any order.
+    int j = 0;
+    for (int i = 0; i < N_hdus; i++) for (long p = 0; p < hdus[i].planes; p++){
+        (*results)[j].hdu = i; (*results)[j].plane = p; j++;
+    }
+
+    __planes_args a = {path, hdus, threshold, *results};
+    run_bands(__analyse_planes, &a, N);
+
+    return N;
+}
+
+/// @brief Frees the results of analyse_planes.
+void free_plane_results (plane_result results [], int N){
+    for (int i = 0; i < N; i++) free(results[i].stars);
+    free(results);
+}
\ No newline at end of file
@@ -17,6 +17,8 @@ typedef struct {
     int PGM; // 0 if file is .fits type, 1 if file is .pgm file.
     double avg; // Average pixel value.
     unsigned short * data; // Data array.
+    hdu * hdus; // Every HDU in the file, NULL for PGM files.
+    int N_hdus; // Number of HDUs, 0 for PGM files.
 } picture;
 
 // Vector struct.
@@ -35,17 +37,72 @@ typedef struct {
     double HFD; // Star half flux diameter.
 } star;
 
+// Bit-packed mask of the pixels above the detection threshold.
+typedef struct {
+    int width; // Image width.
+    int height; // Image height.
+    int words; // Number of 64 bit words per row.
+    unsigned long long * bits; // Bit x%64 of word x/64 of a row is set if pixel x is above the threshold.
+    unsigned char * rows; // 1 if a row has any bit set, 0 otherwise.
+} thres_mask;
+
+// Star extraction results of a single plane.
+typedef struct {
+    int hdu; // Index of the HDU the plane is in.
+    long plane; // Index of the plane within the HDU.
+    int err; // 0 if the plane was analysed, the error code of reading it otherwise.
+    double avg; // Average pixel value.
+    int thres; // Star detection threshold.
+    int N; // Number of extracted stars.
+    star * stars; // Extracted stars.
+} plane_result;
+
 /// @brief Reads the contents of a file into a given picture struct.
 /// @param path Should have .pgm or .fits extension.
 /// @param RGB_to_mono RGB to monochrome conversion function.
-/// @return -1 if path invalid, -2 if file invalid, -3 if allocation failed, 0 otherwise.
+/// @return -1 if path invalid, -2 if file invalid, -3 if allocation failed, -4 if the file ended preemptively, -5 if the image format is unsupported, 0 otherwise.
+/// FITS files are indexed into img->hdus, which should be freed by the caller along with img->data.
 int read_starfile (char const * path, picture * img);
 
+/// @brief Reads a single plane of a FITS HDU into a given picture struct, converting to physical values and debayering if needed.
+/// @param h Should come from read_starfile or index_fits on the same file.
+/// @param plane Index of the plane, 0 for 2-D images.
+/// @return -2 if the HDU has no such plane, -3 if allocation failed, -4 if the file ended preemptively, -5 if the BITPIX is unsupported, 0 otherwise.
+int read_plane (FILE * fptr, hdu const * h, long plane, picture * img);
+
+/// @brief Marks the pixels above img->thres in a newly allocated mask.
+/// @param img Should be run through the "read" function first.
+/// @return -1 if allocation failed, 0 otherwise.
+int build_thres_mask (picture * img, thres_mask * mask);
+
+/// @brief Checks if a pixel is above the threshold of the mask.
+/// @return 1 if it is, 0 otherwise.
+int thres_mask_get (thres_mask const * mask, int x, int y);
+
+/// @brief Frees the arrays of a mask.
+void free_thres_mask (thres_mask * mask);
+
 /// @brief Extracts stars from the given file into the given array.
 /// @param img Should be run through the "read" function first.
 /// @param stars Should be the size of N_stars or bigger.
 /// @param N_stars Maximum number of stars to extract.
-/// @return Number of extracted stars.
+/// @return Number of extracted stars; -1 if allocation failed.
 int extract_stars (picture * img, star stars [], int N_stars);
 
+/// @brief Extracts all stars from the given file into a newly allocated array.
+/// @param img Should be run through the "read" function first.
+/// @param stars Stores the allocated array here, should be freed by the caller.
+/// @return Number of extracted stars; -1 if allocation failed.
+int extract_all_stars (picture * img, star ** stars);
+
+/// @brief Extracts the stars of every plane of every HDU in a FITS file, planes are split over threads.
+/// @param hdus Should come from read_starfile or index_fits on the same file.
+/// @param threshold Calculates the star detection threshold from the average pixel value of a plane.
+/// @param results Stores a newly allocated array of results here, one per plane in HDU order. Should be freed with free_plane_results.
+/// @return Number of planes; -3 if allocation failed.
+int analyse_planes (char const * path, hdu const hdus [], int N_hdus, int (* threshold) (double avg), plane_result ** results);
+
+/// @brief Frees the results of analyse_planes.
+void free_plane_results (plane_result results [], int N);
+
 # endif
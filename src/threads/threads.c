@@ -0,0 +1,57 @@
+# include "threads.h"
+
+# include <pthread.h>
+# include <unistd.h> // Not in the header, its close() clashes with the one in analyse.c.
+
+// Arguments of a single band.
+typedef struct {
+    band_fn fn; // Work function.
+    void * arg; // Shared argument.
+    int start; // First item of the band.
+    int end; // Item after the last item of the band.
+} __band;
+
+__thread int __in_band = 0; // 1 while this thread is running a band, nested calls then stay on this thread.
+
+/// @brief Number of threads to split work over. (One per online processor)
+int n_threads (){
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n < 1) return 1;
+    return ( int ) n;
+}
+
+/// @brief Thread entry point, runs a single band.
+void * __run_band (void * arg){
+    __band * b = ( __band * ) arg;
+    int nested = __in_band;
+    __in_band = 1;
+    b->fn(b->arg, b->start, b->end);
+    __in_band = nested;
+    return NULL;
+}
+
+/// @brief Splits N items into contiguous bands and processes one band per thread.
+/// @param fn Work function, called once per band.
+/// @param arg Passed to every call of fn, should not be written to without care.
+/// @param N Number of items.
+void run_bands (band_fn fn, void * arg, int N){
+    int T = __in_band ? 1 : n_threads(); // Threads are already busy when nested, eg. detecting stars per plane.
+    if (T > N) T = N;
+    if (T <= 1) { if (N > 0) fn(arg, 0, N); return; }
+
+    pthread_t threads [T]; __band bands [T]; int started [T];
+    for (int t = 0; t < T; t++){
+        bands[t].fn = fn; bands[t].arg = arg;
+        bands[t].start = ( int ) (( long ) N * t / T);
+        bands[t].end = ( int ) (( long ) N * (t+1) / T);
+    }
+
+    // The calling thread takes the first band itself.
+    for (int t = 1; t < T; t++) started[t] = pthread_create(&threads[t], NULL, __run_band, &bands[t]) == 0;
+    __run_band(&bands[0]);
+
+    for (int t = 1; t < T; t++){
+        if (started[t]) pthread_join(threads[t], NULL);
+        else __run_band(&bands[t]); // Couldn't start a thread, do the work here instead.
+    }
+}
\ No newline at end of file
@@ -0,0 +1,17 @@
+# ifndef THREADS_H__
+# define THREADS_H__
+
+// Work function, should process the items from start up to but not including end.
+typedef void (* band_fn) (void * arg, int start, int end);
+
+/// @brief Number of threads to split work over. (One per online processor)
+int n_threads ();
+
+/// @brief Splits N items into contiguous bands and processes one band per thread.
+/// Nested calls from inside a work function run on the calling thread.
+/// @param fn Work function, called once per band.
+/// @param arg Passed to every call of fn, should not be written to without care.
+/// @param N Number of items.
+void run_bands (band_fn fn, void * arg, int N);
+
+# endif
@@ -0,0 +1,174 @@
+# include "warp.h"
+# include "../threads/threads.h"
+
+# ifdef __SSE2__
+# include <emmintrin.h>
+# endif
+
+# ifndef M_PI
+# define M_PI 3.14159265358979323846
+# endif
+
+// Some constants.
+int const __PHASES = 64, // Number of subpixel steps the kernel weights are tabulated for.
+__WARP_TILE = 64, // Output tiles are this many pixels wide and high.
+__MAX_TAPS = 6; // Taps of the widest kernel. (Lanczos-3)
+
+// Arguments shared by the threads of a warp.
+typedef struct {
+    picture const * img; // Picture to resample.
+    affine const * T; // Output to input transform.
+    unsigned short * dst; // Output data.
+    float const * table; // Kernel weights, taps weights per phase.
+    int taps; // Number of taps per direction.
+    int tiles_x; // Number of tiles per row of tiles.
+} __warp_args;
+
+/// @brief Inverts an affine transform.
+/// @return -1 if the transform can't be inverted, 0 otherwise.
+int invert_affine (affine const * T, affine * inv){
+    double det = T->a*T->e - T->b*T->d;
+    if (det == 0.0) return -1; // Singular.
+
+    affine r;
+    r.a = T->e / det; r.b = -T->b / det;
+    r.d = -T->d / det; r.e = T->a / det;
+    r.c = -(r.a*T->c + r.b*T->f);
+    r.f = -(r.d*T->c + r.e*T->f);
+    *inv = r;
+
+    return 0;
+}
+
+/// @brief Evaluates the resampling kernel at distance t.
+double __kernel_weight (warp_kernel kernel, double t){
+    t = fabs(t);
+    switch (kernel){
+        case WARP_BILINEAR:
+            return t < 1.0 ? 1.0 - t : 0.0;
+        case WARP_BICUBIC: // Keys cubic convolution with a = -0.5.
+            if (t <= 1.0) return (1.5*t - 2.5)*t*t + 1.0;
+            if (t < 2.0) return ((-0.5*t + 2.5)*t - 4.0)*t + 2.0;
+            return 0.0;
+        case WARP_LANCZOS3:
+            if (t == 0.0) return 1.0;
+            if (t >= 3.0) return 0.0;
+            return 3.0 * sin(M_PI*t) * sin(M_PI*t/3.0) / (M_PI*M_PI*t*t);
+    }
+    return 0.0;
+}
+
+/// @brief Number of taps per direction of the resampling kernel.
+int __kernel_taps (warp_kernel kernel){
+    if (kernel == WARP_BILINEAR) return 2;
+    if (kernel == WARP_BICUBIC) return 4;
+    return __MAX_TAPS;
+}
+
+/// @brief Tabulates the kernel weights for every subpixel phase, normalised so they add up to one.
+/// @param table Should hold (__PHASES+1)*taps floats.
+void __fill_table (warp_kernel kernel, int taps, float * table){
+    for (int p = 0; p <= __PHASES; p++){
+        double frac = ( double ) p / ( double ) __PHASES, s = 0.0, w [__MAX_TAPS];
+        for (int t = 0; t < taps; t++){
+            w[t] = __kernel_weight(kernel, ( double ) (t - (taps/2 - 1)) - frac); // Distance from tap to sample position.
+            s += w[t];
+        }
+        for (int t = 0; t < taps; t++) table[p*taps + t] = ( float ) (w[t] / s);
+    }
+}
+
+/// @brief Adds the weighted sum of taps pixels of one picture row to acc, all 4 values of a pixel at once.
+/// @param px Pixel pointers, NULL if the taps are consecutive starting at row.
+void __tap_row (float acc [4], unsigned short const * row, unsigned short const * const px [], float const * wx, float wy, int taps){
+# ifdef __SSE2__
+    __m128i zero = _mm_setzero_si128();
+    __m128 h = _mm_setzero_ps();
+    for (int t = 0; t < taps; t++){
+        unsigned short const * p = px != NULL ? px[t] : row + t*4;
+        __m128 v = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_loadl_epi64(( __m128i const * ) p), zero)); // 4 values to floats.
+        h = _mm_add_ps(h, _mm_mul_ps(_mm_set1_ps(wx[t]), v));
+    }
+    _mm_storeu_ps(acc, _mm_add_ps(_mm_loadu_ps(acc), _mm_mul_ps(_mm_set1_ps(wy), h)));
+# else
+    float h [4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    for (int t = 0; t < taps; t++){
+        unsigned short const * p = px != NULL ? px[t] : row + t*4;
+        for (int c = 0; c < 4; c++) h[c] += wx[t] * ( float ) p[c];
+    }
+    for (int c = 0; c < 4; c++) acc[c] += wy * h[c];
+# endif
+}
+
+/// @brief Splits a sample position in its first tap and the weights of the taps.
+/// @return Index of the first tap.
+int __split (double s, float const * table, int taps, float const ** w){
+    double fl = floor(s);
+    int i = ( int ) fl, phase = ( int ) ((s - fl) * __PHASES + 0.5);
+    *w = table + phase*taps;
+    return i - (taps/2 - 1);
+}
+
+/// @brief Resamples a band of output tiles.
+void __warp_tiles (void * arg, int start, int end){
+    __warp_args * a = ( __warp_args * ) arg;
+    picture const * img = a->img; affine const * T = a->T;
+    int W = img->width, H = img->height, taps = a->taps;
+    unsigned short const * px [__MAX_TAPS];
+
+    for (int tile = start; tile < end; tile++){
+        int x0 = (tile % a->tiles_x) * __WARP_TILE, y0 = (tile / a->tiles_x) * __WARP_TILE,
+        x1 = x0 + __WARP_TILE < W ? x0 + __WARP_TILE : W, y1 = y0 + __WARP_TILE < H ? y0 + __WARP_TILE : H;
+
+        for (int y = y0; y < y1; y++){
+            unsigned short * out = a->dst + (( long ) y*W + x0)*4;
+            double sx = T->a*x0 + T->b*y + T->c, sy = T->d*x0 + T->e*y + T->f; // Step along the row instead of transforming every pixel.
+
+            for (int x = x0; x < x1; x++, out += 4, sx += T->a, sy += T->d){
+                if (sx < -0.5 || sy < -0.5 || sx > W - 0.5 || sy > H - 0.5) { out[0] = out[1] = out[2] = out[3] = 0; continue; } // Outside the picture.
+
+                float const * wx, * wy;
+                int ix = __split(sx, a->table, taps, &wx), iy = __split(sy, a->table, taps, &wy);
+                float acc [4] = {0.0f, 0.0f, 0.0f, 0.0f};
+
+                if (ix >= 0 && iy >= 0 && ix + taps <= W && iy + taps <= H){ // Fully inside, taps are consecutive.
+                    for (int t = 0; t < taps; t++) __tap_row(acc, img->data + (( long ) (iy + t)*W + ix)*4, NULL, wx, wy[t], taps);
+                } else { // Near the edge, replicate the edge pixels.
+                    for (int t = 0; t < taps; t++){
+                        int r = iy + t; r = r < 0 ? 0 : r; r = r >= H ? H-1 : r;
+                        for (int u = 0; u < taps; u++){
+                            int c = ix + u; c = c < 0 ? 0 : c; c = c >= W ? W-1 : c;
+                            px[u] = img->data + (( long ) r*W + c)*4;
+                        }
+                        __tap_row(acc, NULL, px, wx, wy[t], taps);
+                    }
+                }
+
+                for (int c = 0; c < 4; c++){ // Round and clamp, the sharper kernels can over- and undershoot.
+                    float v = acc[c] + 0.5f;
+                    v = v < 0.0f ? 0.0f : v; v = v > 65535.0f ? 65535.0f : v;
+                    out[c] = ( unsigned short ) v;
+                }
+            }
+        }
+    }
+}
+
+/// @brief Resamples the picture onto a grid of the same size through the given transform.
+/// @param T Maps output pixel positions to positions in the picture, use invert_affine on a picture to output transform.
+/// @param kernel Resampling kernel.
+/// @param dst Should hold width*height*4 values, same layout as img->data. Pixels that map outside the picture are set to 0.
+/// @return -1 if allocation failed, 0 otherwise.
+int warp_picture (picture const * img, affine const * T, warp_kernel kernel, unsigned short * dst){
+    int taps = __kernel_taps(kernel);
+    float * table = ( float * ) malloc((__PHASES+1) * taps * sizeof(float));
+    if (table == NULL) return -1; // Malloc failed.
+    __fill_table(kernel, taps, table);
+
+    __warp_args a = {img, T, dst, table, taps, (img->width + __WARP_TILE-1) / __WARP_TILE};
+    int tiles_y = (img->height + __WARP_TILE-1) / __WARP_TILE;
+    run_bands(__warp_tiles, &a, a.tiles_x * tiles_y);
+
+    free(table);
+    return 0;
+}
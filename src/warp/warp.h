@@ -0,0 +1,37 @@
+# ifndef WARP_H__
+# define WARP_H__
+
+# include <stdlib.h>
+# include <math.h>
+
+# include "../stardet/stardet.h"
+
+// Affine transform, maps pixel (x, y) to (a*x + b*y + c, d*x + e*y + f).
+typedef struct {
+    double a;
+    double b;
+    double c;
+    double d;
+    double e;
+    double f;
+} affine;
+
+// Resampling kernels.
+typedef enum {
+    WARP_BILINEAR, // 2x2 taps, fastest but softens the picture.
+    WARP_BICUBIC, // 4x4 taps. (Keys, a = -0.5)
+    WARP_LANCZOS3 // 6x6 taps, sharpest but can ring around bright stars.
+} warp_kernel;
+
+/// @brief Inverts an affine transform.
+/// @return -1 if the transform can't be inverted, 0 otherwise.
+int invert_affine (affine const * T, affine * inv);
+
+/// @brief Resamples the picture onto a grid of the same size through the given transform.
+/// @param T Maps output pixel positions to positions in the picture, use invert_affine on a picture to output transform.
+/// @param kernel Resampling kernel.
+/// @param dst Should hold width*height*4 values, same layout as img->data. Pixels that map outside the picture are set to 0.
+/// @return -1 if allocation failed, 0 otherwise.
+int warp_picture (picture const * img, affine const * T, warp_kernel kernel, unsigned short * dst);
+
+# endif